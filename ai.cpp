@@ -5,21 +5,59 @@
 
 #include "game.h"
 #include "ai.h"
+#include "workPool.h"
 #include <iostream>
 #include <time.h>
 #include <fstream>
-#include <queue>
+#include <algorithm>
+#include <thread>
 
 using namespace std;
 
-vector<action> ai::ht;
+ai::ai(int new_strategy, char historyTableIndex, int threads)
+{
+    strategy = new_strategy;
+    htFile.insert(htFile.begin()+12,historyTableIndex);
+    numThreads = threads;
+    stacks.emplace_back(MAX_PLY);
+    tt = make_shared<transTable>(TT_SIZE_MB);
+    bitbases = make_shared<bitbase>();
+    book = make_shared<openingBook>();
+    stats = make_shared<searchStats>(threads);
+    localStats = &stats->thread(0);
+    stopSearch = make_shared<atomic<bool>>(false);
+    ponderHit = make_shared<atomic<bool>>(false);
+}
 
 action ai::runTurn()
 {
 	action nextMove;
+	bool searched = false;
 
 	//Determine the starting time of execution to calculate time passage
-	clock_t startTime = clock();
+	gameClock::time_point startTime = gameClock::now();
+
+	//Resolve a search started on the opponent's time. If the opponent made the
+	//predicted move the ponder search becomes this turn's search, otherwise it is discarded.
+	if(isPondering)
+	{
+		if(!target_game->move_log.empty() && target_game->move_log.back() == ponderMove)
+		{
+			ponderHit->store(true);
+			ponderThread->join();
+			nextMove = ponderResult;
+			searched = true;
+		}
+		else
+		{
+			stopSearch->store(true);
+			ponderThread->join();
+			stopSearch->store(false);
+		}
+		isPondering = false;
+		delete ponderState;
+		ponderState = NULL;
+	}
 
 	//Copy the current board state from the game hub
 	state boardState;
@@ -29,31 +67,26 @@ action ai::runTurn()
 
 	boardState.updateMaterialDifference();
 
-	bool isOpening;
-
 	srand(time(NULL));
 
-	//Determine if the game is still in the opening phase
-	if(target_game->currentTurn < 30)
-	{
-		if(boardState.currentPlayer->rankDirection == 1)
-		{
-			isOpening = (target_game->currentTurn < 20 || !boardState.whiteHasCastled);
-		}
-		else
-		{
-			isOpening = (target_game->currentTurn < 20 || !boardState.blackHasCastled);
-		}
-	}
+	//Play straight from the opening book while it knows the position
+	if(!searched && book->findMove(boardState, nextMove, bookRandom))
+		searched = true;
 
-	boardState.utilityValue = boardState.calculateUtility(isOpening, strategy);
+	if(!searched)
+		boardState.utilityValue = boardState.calculateUtility(strategy);
 
 	//Retreive the history table from a file on the first turn
-	if(target_game->currentTurn < 2)
+	if(persistHistory && target_game->currentTurn < 2)
 		getHistoryTable(boardState);
 
 	//Determine the best action to take
-	nextMove = IDABminimax(boardState, startTime, isOpening);
+	if(!searched)
+	{
+		turnLimits = gameLimits(boardState.currentPlayer->rankDirection, 0);
+		stopSearch->store(false);
+		nextMove = search(boardState, startTime);
+	}
 	//Update the static castling records if a castle move occurs
 	if(nextMove.isCastle)
 	{
@@ -63,13 +96,149 @@ action ai::runTurn()
 			boardState.blackHasCastled = true;
 	}
 
+	//Remember the opponent's expected reply so it can be pondered
+	if(ponderEnabled)
+		hasPonderMove = findPonderMove(boardState, nextMove);
+
 	//Store the history table in a file and age it's contents
-	storeHistoryTable(boardState.whiteHasCastled, boardState.blackHasCastled);
+	if(persistHistory)
+		storeHistoryTable(boardState.whiteHasCastled, boardState.blackHasCastled);
 	ageHistoryTable();
 
 	return nextMove;
 }
 
+//Clears the transposition, history and killer tables
+void ai::newGame()
+{
+	tt->clear();
+	ht.clear();
+	for(unsigned int i = 0; i < stacks.size(); i++)
+		stacks[i].clearKillers();
+}
+
+//Returns the limits for a search by the player moving in turnsAhead turns. Fixed
+//move time, depth, or node limits replace the game clock.
+searchLimits ai::gameLimits(int rankDirection, int turnsAhead)
+{
+	searchLimits result = limits;
+
+	if(limits.moveTime > 0 || limits.depth > 0 || limits.nodes > 0)
+		return result;
+
+	if(rankDirection == 1)
+		result.time = target_game->whiteTimeRemaining;
+	else
+		result.time = target_game->blackTimeRemaining;
+	result.increment = target_game->increment;
+	result.movesToGo = target_game->movesToGo(turnsAhead);
+	return result;
+}
+
+//Runs the search selected by the number of threads and the parallel mode. Every
+//turn's search and every ponder search starts a new transposition table generation,
+//so entries left by earlier moves give way to the results of this one.
+action ai::search(state& s, gameClock::time_point startTime)
+{
+	tt->newSearch();
+	stats->clear();
+	localStats = &stats->thread(0);
+	if(numThreads > 1 && parallelMode == YBWC)
+		return ybwcSearch(s, startTime);
+	else if(numThreads > 1)
+		return lazySMPSearch(s, startTime);
+	else
+		return IDABminimax(s, startTime);
+}
+
+searchReport ai::lastSearchReport()
+{
+	if(stats->reports().empty())
+		return searchReport();
+	return stats->reports().back();
+}
+
+vector<searchReport>& ai::searchReports()
+{
+	return stats->reports();
+}
+
+//Finds the opponent's reply to a in the transposition table. The reply is the second
+//action of the principal variation and the best guess of the opponent's next move.
+bool ai::findPonderMove(state& s, action& a)
+{
+	int ttUtility, ttDepth, ttBound;
+	int ttMove = 0;
+	vector<action> possibleMoves;
+
+	if(a.type == "")
+		return false;
+
+	if(principalVariation.size() >= 2 && principalVariation[0] == a)
+	{
+		ponderMove = principalVariation[1];
+		return true;
+	}
+
+	state child;
+	child = s.result(a, false, strategy, false);
+	if(!tt->probe(child.hashKey, ttUtility, ttDepth, ttBound, ttMove) || ttMove == 0)
+		return false;
+
+	possibleMoves = child.actions();
+	for(unsigned int i = 0; i < possibleMoves.size(); i++)
+	{
+		if(packMove(possibleMoves[i]) == ttMove)
+		{
+			ponderMove = possibleMoves[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+//Starts searching the state that follows the predicted opponent reply in a background
+//thread. Should be called after this ai's action has been applied to the game.
+void ai::startPondering()
+{
+	if(!ponderEnabled || !hasPonderMove || isPondering || target_game->is_game_over())
+		return;
+	if(!target_game->valid_move(ponderMove))
+		return;
+
+	ponderState = new state;
+	*ponderState = target_game->current_state.result(ponderMove, false, strategy, false);
+	ponderState->maxPlayer = ponderState->currentPlayer;
+	ponderState->updateMaterialDifference();
+	ponderState->utilityValue = ponderState->calculateUtility(strategy);
+
+	//the limits are read here because the game changes while the ponder thread runs
+	turnLimits = gameLimits(ponderState->currentPlayer->rankDirection, 1);
+	ponderHit->store(false);
+	stopSearch->store(false);
+	isPondering = true;
+	ponderThread = make_shared<thread>(&ai::ponderSearch, this);
+}
+
+//Abandons a ponder search without using its result
+void ai::stopPondering()
+{
+	if(!isPondering)
+		return;
+	stopSearch->store(true);
+	ponderThread->join();
+	stopSearch->store(false);
+	isPondering = false;
+	delete ponderState;
+	ponderState = NULL;
+}
+
+//Body of the ponder thread. The search ignores the clock until ponderHit is set.
+void ai::ponderSearch()
+{
+	ponderResult = search(*ponderState, gameClock::now());
+}
+
 void ai::initializeHistoryTable()
 {
 	ofstream fout(htFile);
@@ -139,7 +308,6 @@ void ai::storeHistoryTable(bool whiteHasCastled, bool blackHasCastled)
 //if it wasn't there. If the number of actions exceeds the maximum limit, it purges the table
 void ai::updateHistoryTable(action& a)
 {
-    const int MAX_ACTIONS = 300;
     if(a.historyValue > 0)
     {
         unsigned int i = 0;
@@ -154,7 +322,7 @@ void ai::updateHistoryTable(action& a)
         }
     }
 
-    if(ht.size() >= MAX_ACTIONS)
+    if(ht.size() >= (unsigned int)params.maxActions)
     {
         purgeHistoryTable();
     }
@@ -193,11 +361,9 @@ int ai::retrieveHistoryValue(action& a)
 //the table when there are too many entries.
 void ai::purgeHistoryTable()
 {
-    const int AGE_BARRIER = 6;
-
     for(unsigned int i = 0; i < ht.size(); i++)
     {
-        if(ht[i].htAge >= AGE_BARRIER || ht[i].historyValue < 3)
+        if(ht[i].htAge >= params.ageBarrier || ht[i].historyValue < 3)
         {
             ht.erase(ht.begin()+i);
         }
@@ -205,147 +371,774 @@ void ai::purgeHistoryTable()
     return;
 }
 
-//This function return true if the change in utility from the previous state exceeds
-//the change barrier.
-bool ai::isNonquiescent(state& s)
+//The change from its parent's utility a child's lazy utility must surely exceed.
+//Once no quiescent extensions are left any change will do, otherwise the lazy utility
+//must be nonquiescent whatever the terms it skips add, so that the child's
+//isNonquiescent() test gives the same answer as with the exact utility.
+int ai::lazyChange(int quiescentDepth)
 {
-    const int CHANGE_BARRIER = 2000;
-    return abs(s.quiescentChange) > CHANGE_BARRIER;
+    return (quiescentDepth == 0) ? INT_MIN : params.changeBarrier;
 }
 
-//calculates the time remaining when PERCENT_TIME_REMAINING percent of the starting time
-//is used then returns the value. All times are measured in nanoseconds.
-//The percentage of time remaining gives more time early in the game and less towards the end
-//This allows the early turns which have more possible moves to go to deeper depths
-//Late game depths are deeper because there are inherently few moves to be made by fewer pieces
-double ai::timeHeuristic(state& s, clock_t startTime, double timeRemaining, bool isOpening)
+//This function return true if the change in utility from the previous state exceeds
+//the change barrier.
+bool ai::isNonquiescent(state& s)
 {
-    const int PERCENT_TIME_REMAINING = 8;
-    const int OPENING_TIME = 7;
-    double endTime;
-    int percent = PERCENT_TIME_REMAINING;
-    if(isOpening)
-        percent = OPENING_TIME;
-
-    //Calculate how much time should be remaining at the end of contemplation
-    endTime = timeRemaining - (timeRemaining*percent/100);
-
-    //outputs the expected threshold for calculation time
-    //cout << endTime << endl;
-
-    return endTime;
+    return abs(s.quiescentChange) > params.changeBarrier;
 }
 
-//estimates based on the startTime, the time since then, and the endTime whether
-//another iterative depth search can be completed. The estimate averages the
+//estimates based on the startTime and the time since then whether another iterative
+//depth search can be completed within allowance seconds. The estimate averages the
 //breadth of the max player moves and the next layer's min player moves. This average
 //roughly estimates the number of moves at any given depth. The amount of time for a depth
 //should be roughly equal to the time for the previous depth times the average breadth.
-//returns true if the estimated time to search is finished before endTime
+//returns true if the estimated time to search is finished within the allowance
 //returns false if it would exceed the bounds
-bool ai::canCompleteNextDepth(state& s, clock_t startTime, double timeRemaining,  double endTime)
+bool ai::canCompleteNextDepth(state& s, gameClock::time_point startTime, double allowance)
 {
-    double timeElapsed = float(clock() - startTime)/CLOCKS_PER_SEC;
+    double timeElapsed = secondsSince(startTime);
     int averageBreadth;
     vector<action> possibleMoves1;
     vector<action> possibleMoves2;
     action nextAction;
 
     possibleMoves1 = s.actions();
-    possibleMoves2 = s.result(possibleMoves1[0], false, strategy, false, false).actions();
+    possibleMoves2 = s.result(possibleMoves1[0], false, strategy, false).actions();
 
     averageBreadth = (possibleMoves1.size()+possibleMoves2.size())/2;
 
-    if(timeRemaining - (timeElapsed * averageBreadth) > endTime)
+    if(timeElapsed * averageBreadth < allowance)
         return true;
     else
         return false;
 }
 
 //Time-limited Alpha Beta Iterative Deepening Depth-limited Minimax algorithm
-//Runs ABminimax for as many dpeths as possible based on the timeHeuristic and
-//the estimation of whether another depth can be completed within this time limit
-action ai::IDABminimax(state& s, clock_t startTime, bool isOpening)
+//Runs ABminimax for as many depths as the time manager allows based on the
+//estimation of whether another depth can be completed within its soft limit
+action ai::IDABminimax(state& s, gameClock::time_point startTime)
 {
-    const int QUIESCENT_DEPTH = 3;
-    const int MAXDEPTH = 20;
     action result;
     int iterativeDepth = 1;
-    double timeRemaining;
 
-    if(target_game->current_state.currentPlayer->rankDirection == 1)
+    tm.init(turnLimits, s.gamePhase(), params);
+    //the lines of an earlier position must not order the root of this one
+    pvLines.clear();
+
+    //while pondering the clock is ignored until the opponent plays the predicted move,
+    //then the normal time allowance starts from that moment
+    searchStart = startTime;
+    clockRunning = !isPondering;
+
+    //a forced action needs no search when playing on the clock
+    if(tm.isTimed())
     {
-    	timeRemaining = target_game->whiteTimeRemaining;
+        vector<action> possibleMoves = s.actions();
+        if(possibleMoves.size() == 1)
+            return possibleMoves[0];
     }
-    else
+
+    while(iterativeDepth <= params.maxDepth && !tm.depthLimitReached(iterativeDepth) && !stopSearch->load())
     {
-    	timeRemaining = target_game->blackTimeRemaining;
+        checkTime();
+        //no new depth is started once the soft limit would be passed, but the first depth
+        //always runs so that even a nearly empty clock gets an action
+        if(iterativeDepth > 1 && clockRunning && tm.isTimed() && !canCompleteNextDepth(s, searchStart, tm.softLimit()))
+            break;
+        if(clockRunning && verbose)
+            cout << "Iterative Depth: " << iterativeDepth << endl;
+        action next = ABminimax(s, iterativeDepth, params.quiescentDepth);
+        if(stopSearch->load())
+        {
+            //The previous best action is searched first, so any root action that was
+            //completed in the abandoned iteration is at least as well informed as the
+            //previous result. A search stopped by a ponder miss is discarded by runTurn.
+            if(rootMovesSearched > 0 || result.type == "")
+                result = next;
+            break;
+        }
+        result = next;
+        principalVariation = stacks[stackIndex][0].pv;
+        if(!searchPVLines(s, result, iterativeDepth))
+            break;
+        if(multiPV > 1 && clockRunning && verbose)
+            printPVLines();
+        tm.updateBestAction(packMove(result));
+        searchReport report = stats->completeDepth(iterativeDepth, secondsSince(searchStart));
+        if(printStats && clockRunning)
+            cout << report.toJson() << endl;
+        //the time left is saved for harder positions once the best action is clearly best
+        if(clockRunning && tm.isTimed() && isEasyMove(s, result, iterativeDepth))
+            break;
+        iterativeDepth++;
     }
 
-    //calculate the time by which calculations need to be finished
-    double endTime = timeHeuristic(s, startTime, timeRemaining, isOpening);
+    return result;
+}
 
-    while(iterativeDepth <= MAXDEPTH && canCompleteNextDepth(s, startTime, timeRemaining, endTime))
+//Returns true if best has stayed the best action for several depths and a reduced
+//depth search shows every other action falls short of it by at least the margin.
+//The verification searches the other actions with a null window just below the best
+//utility minus the margin, like a singular extension search, so it costs much less
+//than the depth that would follow.
+bool ai::isEasyMove(state& s, action& best, int depth)
+{
+    const int MIN_DEPTH = 4;
+    const int STABLE_DEPTHS = 2;
+    const int MARGIN = 1500;
+
+    if(depth < MIN_DEPTH || tm.stableDepthCount() < STABLE_DEPTHS)
+        return false;
+
+    int verifyBeta = rootUtility - MARGIN;
+    int verifyDepth = depth / 2;
+    vector<action> possibleMoves = s.actions();
+
+    for(unsigned int i = 0; i < possibleMoves.size(); i++)
     {
-        cout << "Iterative Depth: " << iterativeDepth << endl;
-        result = ABminimax(s, iterativeDepth, QUIESCENT_DEPTH, isOpening);
-        iterativeDepth++;
+        if(possibleMoves[i] == best)
+            continue;
+        searchFrame& frame = stacks[stackIndex][0];
+        s.resultInto(frame.child, possibleMoves[i], false, strategy, true, 0);
+        int currentUtility = searchChild(frame.child, true, verifyDepth-1, params.quiescentDepth, verifyBeta-1, verifyBeta, 1);
+        if(searchAborted() || currentUtility >= verifyBeta)
+            return false;
     }
+    return true;
+}
 
+//Counts a node in this thread's statistics and polls the clock every
+//NODE_CHECK_INTERVAL nodes. Nodes at or past the horizon are quiescence nodes.
+void ai::countNode(int depth, int quiescentDepth, int ply)
+{
+    localStats->add(localStats->nodes);
+    if(depth == 0 || quiescentDepth < params.quiescentDepth)
+        localStats->add(localStats->qnodes);
+    localStats->reachPly(ply);
+    if((localStats->nodes.load(memory_order_relaxed) & (NODE_CHECK_INTERVAL - 1)) == 0)
+        checkTime();
+}
+
+//Called every NODE_CHECK_INTERVAL nodes by the thread that owns the search clock.
+//Starts the clock on a ponder hit and stops the search once the hard limit passes
+//or the node limit is reached.
+void ai::checkTime()
+{
+    if(isHelper)
+        return;
+    if(!clockRunning)
+    {
+        if(!isPondering || !ponderHit->load())
+            return;
+        searchStart = gameClock::now();
+        clockRunning = true;
+    }
+    if(tm.nodeLimitReached(stats->totalNodes()))
+        stopSearch->store(true);
+    if(tm.isTimed() && secondsSince(searchStart) >= tm.hardLimit())
+        stopSearch->store(true);
+}
+
+//Lazy SMP search. Every helper is a copy of this ai with its own history and killer
+//tables and its own copy of the board. The helpers run iterative deepening without a
+//time limit, offset by one depth on every other thread so they reach different parts
+//of the tree first, and share everything they learn through the transposition table.
+//Only the main thread's result is returned; the helpers stop once it is found.
+action ai::lazySMPSearch(state& s, gameClock::time_point startTime)
+{
+    action result;
+    vector<ai> helpers;
+    vector<state*> helperStates;
+    vector<thread> threads;
+
+    //copies are made before any thread starts because generating actions
+    //temporarily modifies the state being searched
+    for(int i = 1; i < numThreads; i++)
+    {
+        helpers.push_back(*this);
+        helpers.back().isHelper = true;
+        helpers.back().localStats = &stats->thread(i);
+        state* copy = new state;
+        *copy = s;
+        helperStates.push_back(copy);
+    }
+
+    for(unsigned int i = 0; i < helpers.size(); i++)
+    {
+        threads.push_back(thread(&ai::helperSearch, &helpers[i], ref(*helperStates[i]), i+1));
+    }
+
+    result = IDABminimax(s, startTime);
+
+    stopSearch->store(true);
+    for(unsigned int i = 0; i < threads.size(); i++)
+    {
+        threads[i].join();
+        delete helperStates[i];
+    }
 
     return result;
 }
 
+//Young Brothers Wait search. The main thread runs the usual iterative deepening while
+//the helpers wait in the work pool for split points to appear in the game tree.
+action ai::ybwcSearch(state& s, gameClock::time_point startTime)
+{
+    action result;
+    workPool splitPool(numThreads);
+    vector<ai> workers;
+
+    pool = &splitPool;
+    workerIndex = 0;
+    activeSplit = NULL;
+
+    for(int i = 1; i < numThreads; i++)
+    {
+        workers.push_back(*this);
+        workers.back().isHelper = true;
+        workers.back().workerIndex = i;
+        workers.back().localStats = &stats->thread(i);
+    }
+    splitPool.start(workers);
+
+    result = IDABminimax(s, startTime);
+
+    splitPool.stop();
+    pool = NULL;
+
+    return result;
+}
+
+//Searches the actions remaining in orderedMoves in parallel. The actions are added to
+//this thread's deque in reverse order so this thread takes the best ones first while
+//other threads steal from the other end. This thread keeps executing tasks until every
+//action of the split point is finished. Returns true if an action caused a cutoff,
+//in which case bestAction holds that action.
+bool ai::splitSearch(state& s, vector<action>& orderedMoves, bool isMaxNode, int depth, int quiescentDepth,
+                     int& alpha, int& beta, bool calcUtil, int ply, int& bestUtility, action& bestAction)
+{
+    splitPoint sp;
+    splitTask task;
+    vector<action> remaining;
+
+    sp.parent = activeSplit;
+    sp.nodeState = s;
+    sp.isMaxNode = isMaxNode;
+    sp.depth = depth;
+    sp.quiescentDepth = quiescentDepth;
+    sp.ply = ply;
+    sp.calcUtil = calcUtil;
+    sp.staticEval = stacks[stackIndex][ply].staticEval;
+    sp.alpha = alpha;
+    sp.beta = beta;
+    sp.bestUtility = bestUtility;
+    sp.bestAction = bestAction;
+
+    while(!orderedMoves.empty())
+    {
+        remaining.push_back(orderedMoves.front());
+        popMove(orderedMoves);
+    }
+    sp.pending = remaining.size();
+    task.sp = &sp;
+    for(int i = remaining.size() - 1; i >= 0; i--)
+    {
+        task.move = remaining[i];
+        pool->push(workerIndex, task);
+    }
+
+    //help with the split point's tasks first, then with any other thread's tasks
+    while(sp.pending.load() > 0)
+    {
+        if(pool->pop(workerIndex, task) || pool->steal(workerIndex, task))
+            executeTask(task);
+        else
+            this_thread::yield();
+    }
+
+    //the tasks do not report their principal variations, so an improvement found
+    //by one of them leaves only its action as the node's principal variation
+    if(!sp.cutoff && (sp.alpha != alpha || sp.beta != beta))
+        stacks[stackIndex][ply].pv.assign(1, sp.bestAction);
+
+    alpha = sp.alpha;
+    beta = sp.beta;
+    bestUtility = sp.bestUtility;
+    bestAction = sp.bestAction;
+    return sp.cutoff;
+}
+
+//Searches the subtree of a single split point action and merges its utility into the
+//split point. Tasks of split points that were already cut off are skipped.
+void ai::executeTask(splitTask& task)
+{
+    splitPoint* sp = task.sp;
+
+    if(!sp->isAborted())
+    {
+        int alpha;
+        int beta;
+        int currentUtility;
+
+        //every task nested inside another gets a stack of its own, because the frames
+        //of the search this thread interrupted are still in use
+        stackIndex++;
+        if((int)stacks.size() <= stackIndex)
+            stacks.emplace_back(MAX_PLY);
+        searchFrame& nodeFrame = stacks[stackIndex][sp->ply-1];
+        searchFrame& frame = stacks[stackIndex][sp->ply];
+
+        //the split point's state is shared, so it is copied before generating the child
+        nodeFrame.child = sp->nodeState;
+        sp->lock.lock();
+        alpha = sp->alpha;
+        beta = sp->beta;
+        sp->lock.unlock();
+        nodeFrame.child.resultInto(frame.child, task.move, sp->calcUtil, strategy, true, sp->staticEval,
+                                   alpha, beta, lazyChange(sp->quiescentDepth));
+
+        splitPoint* previousSplit = activeSplit;
+        activeSplit = sp;
+        currentUtility = searchChild(frame.child, sp->isMaxNode, sp->depth-1, sp->quiescentDepth, alpha, beta, sp->ply+1);
+        activeSplit = previousSplit;
+        stackIndex--;
+
+        sp->lock.lock();
+        if(!sp->isAborted())
+        {
+            if(sp->isMaxNode)
+            {
+                if(currentUtility > sp->bestUtility)
+                {
+                    sp->bestUtility = currentUtility;
+                    sp->bestAction = task.move;
+                }
+                if(currentUtility > sp->alpha)
+                    sp->alpha = currentUtility;
+            }
+            else
+            {
+                if(currentUtility < sp->bestUtility)
+                {
+                    sp->bestUtility = currentUtility;
+                    sp->bestAction = task.move;
+                }
+                if(currentUtility < sp->beta)
+                    sp->beta = currentUtility;
+            }
+            if(sp->beta <= sp->alpha)
+            {
+                //the cutoff action is reported as the best action
+                sp->bestAction = task.move;
+                sp->cutoff = true;
+                sp->aborted = true;
+            }
+        }
+        sp->lock.unlock();
+    }
+    sp->pending--;
+}
+
+//Loop run by the helper threads of a YBWC search, stealing tasks until the pool stops
+void ai::workerLoop()
+{
+    splitTask task;
+    while(!pool->isStopped())
+    {
+        if(pool->steal(workerIndex, task))
+            executeTask(task);
+        else
+            this_thread::yield();
+    }
+}
+
+//Returns true if the current search or the split point being worked on was abandoned
+bool ai::searchAborted()
+{
+    if(stopSearch->load(memory_order_relaxed))
+        return true;
+    return activeSplit != NULL && activeSplit->isAborted();
+}
+
+//Iterative deepening run by a helper thread until the main thread signals it to stop
+void ai::helperSearch(state& s, int helperIndex)
+{
+    int iterativeDepth = 1 + helperIndex % 2;
+
+    while(iterativeDepth <= params.maxDepth && !stopSearch->load(memory_order_relaxed))
+    {
+        ABminimax(s, iterativeDepth, params.quiescentDepth);
+        iterativeDepth++;
+    }
+}
+
+//Orders possibleMoves as a heap prioritized by the transposition table action, then
+//the killer moves of this ply, then the history table values. The actions are added
+//to the heap one at a time so equal priorities come out in the order of a queue.
+void ai::orderMoves(vector<action>& possibleMoves, int ply, int ttMove)
+{
+    const int TT_MOVE_ORDER = 1 << 30;
+    const int KILLER_ORDER = 1 << 29;
+    searchFrame& frame = stacks[stackIndex][ply];
+
+    for(unsigned int i = 0; i < possibleMoves.size(); i++)
+    {
+        possibleMoves[i].historyValue = retrieveHistoryValue(possibleMoves[i]);
+        possibleMoves[i].orderValue = possibleMoves[i].historyValue;
+        if(ttMove != 0 && packMove(possibleMoves[i]) == ttMove)
+            possibleMoves[i].orderValue = TT_MOVE_ORDER;
+        else if(possibleMoves[i] == frame.killers[0])
+            possibleMoves[i].orderValue = KILLER_ORDER + 1;
+        else if(possibleMoves[i] == frame.killers[1])
+            possibleMoves[i].orderValue = KILLER_ORDER;
+        push_heap(possibleMoves.begin(), possibleMoves.begin() + i + 1);
+    }
+}
+
+//Removes the highest priority action from the heap of possibleMoves
+void ai::popMove(vector<action>& possibleMoves)
+{
+    pop_heap(possibleMoves.begin(), possibleMoves.end());
+    possibleMoves.pop_back();
+}
+
+//Remembers an action that caused a cutoff at ply, keeping the previous killer as the second
+void ai::storeKiller(action& a, int ply)
+{
+    searchFrame& frame = stacks[stackIndex][ply];
+    if(frame.killers[0] == a)
+        return;
+    frame.killers[1] = frame.killers[0];
+    frame.killers[0] = a;
+}
+
+//Makes a followed by the principal variation of the next ply the principal variation of ply
+void ai::updatePV(action& a, int ply)
+{
+    vector<action>& pv = stacks[stackIndex][ply].pv;
+    vector<action>& childPV = stacks[stackIndex][ply+1].pv;
+    pv.clear();
+    pv.push_back(a);
+    pv.insert(pv.end(), childPV.begin(), childPV.end());
+}
+
+//Probes the transposition table, counting the probe and whether an entry was found
+bool ai::probeTable(unsigned long long key, int& utility, int& depth, int& bound, int& move)
+{
+    localStats->add(localStats->ttProbes);
+    if(!tt->probe(key, utility, depth, bound, move))
+        return false;
+    localStats->add(localStats->ttHits);
+    return true;
+}
+
+//Looks the state up in the endgame bitbases and sets utility from the maxPlayer's
+//point of view if they cover it
+bool ai::probeBitbase(state& s, int& utility)
+{
+    if(!bitbases->isLoaded())
+        return false;
+    int result = bitbases->probe(s);
+    if(result == BITBASE_UNKNOWN || result == BITBASE_INVALID)
+        return false;
+    localStats->add(localStats->bitbaseHits);
+    if(result == BITBASE_DRAW)
+    {
+        utility = s.DRAWVALUE;
+        return true;
+    }
+    myPlayer* winner = (result == BITBASE_WIN) ? s.currentPlayer : s.currentPlayer->opponent;
+    utility = BITBASE_WIN_VALUE + bitbaseProgress(s, winner);
+    if(winner != s.maxPlayer)
+        utility = -utility;
+    return true;
+}
+
+//Removes the root actions of frame that give away result, the bitbase result of the
+//root state s. A drawn state drops the actions leading to a won state for the opponent.
+//A won state keeps the actions leading to a lost state for the opponent and, as the
+//tables know nothing of repetitions, of those only the ones after which the opponent
+//cannot repeat the position if there are any.
+void ai::keepBitbaseResult(state& s, searchFrame& frame, int result)
+{
+    searchFrame& reply = stacks[stackIndex][1];
+    vector<action> kept;
+    vector<action> unrepeated;
+    for(unsigned int i = 0; i < frame.moves.size(); i++)
+    {
+        s.resultInto(frame.child, frame.moves[i], false, strategy, true, 0);
+        int childResult = bitbases->probe(frame.child);
+        if((result == BITBASE_WIN && childResult != BITBASE_LOSS) || (result == BITBASE_DRAW && childResult == BITBASE_WIN))
+            continue;
+        kept.push_back(frame.moves[i]);
+        if(result != BITBASE_WIN || frame.child.isDraw())
+            continue;
+
+        bool repeats = false;
+        frame.child.actions(reply.moves);
+        for(unsigned int j = 0; j < reply.moves.size() && !repeats; j++)
+        {
+            frame.child.resultInto(reply.child, reply.moves[j], false, strategy, true, 0);
+            repeats = reply.child.isDraw();
+        }
+        if(!repeats)
+            unrepeated.push_back(frame.moves[i]);
+    }
+    if(!unrepeated.empty())
+        frame.moves.swap(unrepeated);
+    else if(!kept.empty())
+        frame.moves.swap(kept);
+}
+
+//Scores how far the winner of a bitbase ending has come: its material lead, its pawns
+//advanced towards promotion, the loser's king driven to the edge and the kings brought
+//together. Among the actions that keep the win the search then prefers those that end it.
+int ai::bitbaseProgress(state& s, myPlayer* winner)
+{
+    const int PAWN_STEP = 300;
+    const int EDGE_WEIGHT = 100;
+    const int KING_DISTANCE_WEIGHT = 50;
+    int progress = 0;
+    myPiece* kings[2] = {NULL, NULL};
+
+    for(int side = 0; side < 2; side++)
+    {
+        myPlayer* player = (side == 0) ? winner : winner->opponent;
+        int sign = (side == 0) ? 1 : -1;
+        for(unsigned int i = 0; i < player->pieces.size(); i++)
+        {
+            myPiece* piece = player->pieces[i];
+            if(piece->type == "Queen")
+                progress += sign * state::weights.queenValue;
+            else if(piece->type == "Rook")
+                progress += sign * state::weights.rookValue;
+            else if(piece->type == "Bishop")
+                progress += sign * state::weights.bishopValue;
+            else if(piece->type == "Knight")
+                progress += sign * state::weights.knightValue;
+            else if(piece->type == "Pawn")
+            {
+                progress += sign * state::weights.pawnValue;
+                if(side == 0)
+                    progress += PAWN_STEP * ((player->rankDirection == 1) ? piece->rank - 2 : 7 - piece->rank);
+            }
+            else
+                kings[side] = piece;
+        }
+    }
+
+    int loserFile = s.fileToInt(kings[1]->file);
+    int edgeDistance = min(loserFile - 1, 8 - loserFile) + min(kings[1]->rank - 1, 8 - kings[1]->rank);
+    int kingDistance = max(abs(loserFile - s.fileToInt(kings[0]->file)), abs(kings[1]->rank - kings[0]->rank));
+    return progress - EDGE_WEIGHT * edgeDistance - KING_DISTANCE_WEIGHT * kingDistance;
+}
+
+//Packs an action into 16 bits for the transposition table. Bits 0-5 hold the starting
+//square, bits 6-11 the destination square, and bits 12-14 the promotion piece.
+int ai::packMove(action& a)
+{
+    if(a.type == "")
+        return 0;
+    int from = (a.oldRank - 1) * 8 + (a.oldFile[0] - 'a');
+    int to = (a.newRank - 1) * 8 + (a.newFile[0] - 'a');
+    int promotion = 0;
+    if(a.promotion != "")
+    {
+        switch(a.promotion[0])
+        {
+            case 'Q':
+                promotion = 1;
+                break;
+            case 'R':
+                promotion = 2;
+                break;
+            case 'B':
+                promotion = 3;
+                break;
+            case 'K':
+                promotion = 4;
+                break;
+        }
+    }
+    return from | (to << 6) | (promotion << 12);
+}
+
+//Runs the ABminimax() compiled for the ai's strategy
+action ai::ABminimax(state& s, int depth, int quiescentDepth)
+{
+    if(strategy == 1)
+        return ABminimax<1>(s, depth, quiescentDepth);
+    else if(strategy == 2)
+        return ABminimax<2>(s, depth, quiescentDepth);
+    return ABminimax<0>(s, depth, quiescentDepth);
+}
+
+int ai::searchChild(state& child, bool isMaxNode, int depth, int quiescentDepth, int alpha, int beta, int ply)
+{
+    if(strategy == 1)
+        return isMaxNode ? ABminValue<1>(child, depth, quiescentDepth, alpha, beta, ply)
+                         : ABmaxValue<1>(child, depth, quiescentDepth, alpha, beta, ply);
+    else if(strategy == 2)
+        return isMaxNode ? ABminValue<2>(child, depth, quiescentDepth, alpha, beta, ply)
+                         : ABmaxValue<2>(child, depth, quiescentDepth, alpha, beta, ply);
+    return isMaxNode ? ABminValue<0>(child, depth, quiescentDepth, alpha, beta, ply)
+                     : ABmaxValue<0>(child, depth, quiescentDepth, alpha, beta, ply);
+}
+
 //Returns the action that leads to the maximum value utility node at the passed depth
-action ai::ABminimax(state& s, int depth, int quiescentDepth, bool isOpening)
+template <int Strategy>
+action ai::ABminimax(state& s, int depth, int quiescentDepth)
 {
-    vector<action> possibleMoves;
-    priority_queue<action> orderedMoves;
+    searchFrame& frame = stacks[stackIndex][0];
     int alpha = -100000;
     int beta = 100000;
     int currentUtility;
     action maxAction;
     action nextAction;
+    int ttUtility, ttDepth, ttBound;
+    int ttMove = 0;
 
-    //generate all actions possible for the current player
-    possibleMoves = s.actions();
-    for(unsigned int i = 0; i < possibleMoves.size(); i++)
-    {
-        possibleMoves[i].historyValue = retrieveHistoryValue(possibleMoves[i]);
-        orderedMoves.push(possibleMoves[i]);
-    }
+    //the best action of the previous iteration is searched first
+    if(rootOrderMove != 0)
+        ttMove = rootOrderMove;
+    else
+        probeTable(s.hashKey, ttUtility, ttDepth, ttBound, ttMove);
+
+    //generate all actions possible for the current player, leaving out the
+    //actions of lines a multi-PV search has already found
+    s.actions(frame.moves);
+    for(unsigned int i = 0; i < excludedRootMoves.size(); i++)
+        frame.moves.erase(remove(frame.moves.begin(), frame.moves.end(), excludedRootMoves[i]), frame.moves.end());
+
+    //in an ending the bitbases cover only the actions keeping its result are searched,
+    //and below them the bitbases only score the leaves so the search can still find
+    //the way to checkmate
+    int rootResult = bitbases->isLoaded() ? bitbases->probe(s) : BITBASE_UNKNOWN;
+    bitbaseLeavesOnly = rootResult != BITBASE_UNKNOWN;
+    if(bitbaseLeavesOnly)
+        keepBitbaseResult(s, frame, rootResult);
+    if(frame.moves.empty())
+        return maxAction;
+    orderMoves(frame.moves, 0, ttMove);
 
     //assume that the first possible move is the maximum utility
-    maxAction = orderedMoves.top();
+    maxAction = frame.moves.front();
+    frame.pv.assign(1, maxAction);
+    rootMovesSearched = 0;
 
-    while(!orderedMoves.empty())
+    while(!frame.moves.empty())
     {
-        nextAction = orderedMoves.top();
-        currentUtility = ABminValue(s.result(nextAction, false, strategy, true, false), depth-1, quiescentDepth, alpha, beta, isOpening);
+        nextAction = frame.moves.front();
+        s.resultInto<Strategy>(frame.child, nextAction, false, true, 0);
+        currentUtility = ABminValue<Strategy>(frame.child, depth-1, quiescentDepth, alpha, beta, 1);
+        //the utility of an action whose search was abandoned is not reliable
+        if(searchAborted())
+            break;
+        rootMovesSearched++;
         //if the current move improves the lower bound, set it as the best move
         if(currentUtility > alpha)
         {
             alpha = currentUtility;
             maxAction = nextAction;
+            updatePV(nextAction, 0);
         }
-        orderedMoves.pop();
+        popMove(frame.moves);
     }
     updateHistoryTable(maxAction);
 
+    //the root's entry is only stored when every action was searched
+    if(!searchAborted() && excludedRootMoves.empty())
+        tt->store(s.hashKey, alpha, depth, TT_EXACT, packMove(maxAction));
+    rootUtility = alpha;
+
     return maxAction;
 }
 
+//Fills pvLines with the line of best, found by the last root search, followed by
+//multiPV-1 further lines. Each further line comes from a root search that excludes
+//the actions of the lines before it, starting with the action that held the same
+//place at the previous depth. Returns false and keeps the previous lines if the
+//search is stopped before every line is found.
+bool ai::searchPVLines(state& s, action& best, int depth)
+{
+    vector<pvLine> lines;
+    pvLine line;
+    //the root actions are only counted when there are further lines to search
+    unsigned int numMoves = (multiPV > 1) ? s.actions().size() : 0;
+
+    line.depth = depth;
+    line.utility = rootUtility;
+    line.pv = stacks[stackIndex][0].pv;
+    lines.push_back(line);
+
+    excludedRootMoves.assign(1, best);
+    while((int)lines.size() < multiPV && excludedRootMoves.size() < numMoves)
+    {
+        rootOrderMove = 0;
+        if(pvLines.size() > lines.size())
+            rootOrderMove = packMove(pvLines[lines.size()].pv[0]);
+        action next = ABminimax(s, depth, params.quiescentDepth);
+        if(searchAborted() || next.type == "")
+            break;
+        line.utility = rootUtility;
+        line.pv = stacks[stackIndex][0].pv;
+        lines.push_back(line);
+        excludedRootMoves.push_back(next);
+    }
+    excludedRootMoves.clear();
+    rootOrderMove = 0;
+    rootUtility = lines[0].utility;
+
+    if(searchAborted())
+        return false;
+    pvLines = lines;
+    return true;
+}
+
+//Prints every line of the last completed depth
+void ai::printPVLines()
+{
+    for(unsigned int i = 0; i < pvLines.size(); i++)
+    {
+        cout << "PV " << i + 1 << " depth " << pvLines[i].depth << " utility " << pvLines[i].utility << ":";
+        for(unsigned int j = 0; j < pvLines[i].pv.size(); j++)
+            cout << " " << moveText(pvLines[i].pv[j]);
+        cout << endl;
+    }
+}
+
+//Returns an action in coordinate notation such as e2e4 or e7e8q
+string ai::moveText(action& a)
+{
+    string text = a.oldFile + to_string(a.oldRank) + a.newFile + to_string(a.newRank);
+    if(a.promotion == "Knight")
+        text += "n";
+    else if(a.promotion != "")
+        text += (char)tolower(a.promotion[0]);
+    return text;
+}
+
 //Returns the maximum utility that can be reached at depth away from this state
 //using alpha beta pruning
-int ai::ABmaxValue(state s, int depth, int quiescentDepth, int alpha, int beta, bool isOpening)
+template <int Strategy>
+int ai::ABmaxValue(state& s, int depth, int quiescentDepth, int alpha, int beta, int ply)
 {
+    searchFrame& frame = stacks[stackIndex][ply];
     bool calcUtil = false;
+    frame.pv.clear();
+    countNode(depth, quiescentDepth, ply);
+    if(searchAborted())
+        return alpha;
     if(depth == 1)
         calcUtil = true;
     if(s.isTerminalState)
     {
-        return s.calculateUtility(isOpening, strategy);
+        return s.calculateUtility<Strategy>();
     }
+    //endings covered by the bitbases are decided without a search
+    int bitbaseUtility;
+    if((depth == 0 || !bitbaseLeavesOnly) && probeBitbase(s, bitbaseUtility))
+        return max(alpha, min(beta, bitbaseUtility));
     if(depth == 0)
     {
         if(!isNonquiescent(s))
@@ -367,25 +1160,64 @@ int ai::ABmaxValue(state s, int depth, int quiescentDepth, int alpha, int beta,
     }
 
     int currentUtility;
-    vector<action> possibleMoves;
-    priority_queue<action> orderedMoves;
     int bestUtility = -100000;
+    int alphaOrig = alpha;
     action bestAction;
     action nextAction;
+    int ttUtility, ttDepth, ttBound;
+    int ttMove = 0;
+    bool eldestSearched = false;
 
-    //generate all possible actions from this board state
-    possibleMoves = s.actions();
-    for(unsigned int i = 0; i < possibleMoves.size(); i++)
+    //use a stored result if it was searched deep enough to decide this state
+    if(probeTable(s.hashKey, ttUtility, ttDepth, ttBound, ttMove) && ttDepth >= depth)
     {
-        possibleMoves[i].historyValue = retrieveHistoryValue(possibleMoves[i]);
-        orderedMoves.push(possibleMoves[i]);
+        if(ttBound == TT_EXACT)
+            return max(alpha, min(beta, ttUtility));
+        if(ttBound == TT_LOWER && ttUtility >= beta)
+            return beta;
+        if(ttBound == TT_UPPER && ttUtility <= alpha)
+            return alpha;
     }
 
+    //without an action from a previous iteration a shallower search of this state
+    //provides one, so the full depth search does not start from history values
+    if(ttMove == 0 && depth >= IID_MIN_DEPTH)
+    {
+        ABmaxValue<Strategy>(s, depth - IID_REDUCTION, quiescentDepth, alpha, beta, ply);
+        if(searchAborted())
+            return alpha;
+        tt->probe(s.hashKey, ttUtility, ttDepth, ttBound, ttMove);
+    }
+
+    //generate all possible actions from this board state
+    s.actions(frame.moves);
+    orderMoves(frame.moves, ply, ttMove);
+    //the children compare their utility against this state's utility
+    if(calcUtil)
+        frame.staticEval = s.calculateUtility<Strategy>();
+
     //for each action determine if it provides a new max utility
-    while(!orderedMoves.empty())
+    while(!frame.moves.empty())
     {
-        nextAction = orderedMoves.top();
-        currentUtility = ABminValue(s.result(nextAction, calcUtil, strategy, true, isOpening), depth-1, quiescentDepth, alpha, beta, isOpening);
+        //once the eldest brother is searched the rest can be shared with idle threads
+        if(pool != NULL && depth >= MIN_SPLIT_DEPTH && frame.moves.size() > 1 && eldestSearched)
+        {
+            if(splitSearch(s, frame.moves, true, depth, quiescentDepth, alpha, beta, calcUtil, ply, bestUtility, bestAction))
+            {
+                localStats->add(localStats->cutoffs);
+                updateHistoryTable(bestAction);
+                storeKiller(bestAction, ply);
+                if(!searchAborted())
+                    tt->store(s.hashKey, alpha, depth, TT_LOWER, packMove(bestAction));
+                //Prune
+                return alpha;
+            }
+            break;
+        }
+        nextAction = frame.moves.front();
+        s.resultInto<Strategy>(frame.child, nextAction, calcUtil, true, frame.staticEval,
+                               alpha, beta, lazyChange(quiescentDepth));
+        currentUtility = ABminValue<Strategy>(frame.child, depth-1, quiescentDepth, alpha, beta, ply+1);
         if(currentUtility > bestUtility)
         {
             bestAction = nextAction;
@@ -395,30 +1227,50 @@ int ai::ABmaxValue(state s, int depth, int quiescentDepth, int alpha, int beta,
         {
             //better move found, update lower bound
             alpha = currentUtility;
+            updatePV(nextAction, ply);
         }
         if(beta <= alpha)
         {
+            localStats->add(localStats->cutoffs);
+            if(!eldestSearched)
+                localStats->add(localStats->firstMoveCutoffs);
             updateHistoryTable(nextAction);
+            storeKiller(nextAction, ply);
+            if(!searchAborted())
+                tt->store(s.hashKey, alpha, depth, TT_LOWER, packMove(nextAction));
             //Prune
             return alpha;
         }
-        orderedMoves.pop();
+        popMove(frame.moves);
+        eldestSearched = true;
     }
     updateHistoryTable(bestAction);
+    if(!searchAborted())
+        tt->store(s.hashKey, alpha, depth, (alpha > alphaOrig) ? TT_EXACT : TT_UPPER, packMove(bestAction));
     return alpha;
 }
 
 //returns the minimum utility that can be reached at depth away from this state
 //using alpha beta pruning
-int ai::ABminValue(state s, int depth, int quiescentDepth, int alpha, int beta, bool isOpening)
+template <int Strategy>
+int ai::ABminValue(state& s, int depth, int quiescentDepth, int alpha, int beta, int ply)
 {
+    searchFrame& frame = stacks[stackIndex][ply];
     bool calcUtil = false;
+    frame.pv.clear();
+    countNode(depth, quiescentDepth, ply);
+    if(searchAborted())
+        return beta;
     if(depth == 1)
         calcUtil = true;
     if(s.isTerminalState)
     {
-        return s.calculateUtility(isOpening, strategy);
+        return s.calculateUtility<Strategy>();
     }
+    //endings covered by the bitbases are decided without a search
+    int bitbaseUtility;
+    if((depth == 0 || !bitbaseLeavesOnly) && probeBitbase(s, bitbaseUtility))
+        return max(alpha, min(beta, bitbaseUtility));
     if(depth == 0)
     {
         if(!isNonquiescent(s))
@@ -441,22 +1293,61 @@ int ai::ABminValue(state s, int depth, int quiescentDepth, int alpha, int beta,
 
     int currentUtility;
     int bestUtility = 100000;
-    vector<action> possibleMoves;
-    priority_queue<action> orderedMoves;
+    int betaOrig = beta;
     action nextAction;
     action bestAction;
+    int ttUtility, ttDepth, ttBound;
+    int ttMove = 0;
+    bool eldestSearched = false;
 
-    possibleMoves = s.actions();
-    for(unsigned int i = 0; i < possibleMoves.size(); i++)
+    //use a stored result if it was searched deep enough to decide this state
+    if(probeTable(s.hashKey, ttUtility, ttDepth, ttBound, ttMove) && ttDepth >= depth)
     {
-        possibleMoves[i].historyValue = retrieveHistoryValue(possibleMoves[i]);
-        orderedMoves.push(possibleMoves[i]);
+        if(ttBound == TT_EXACT)
+            return max(alpha, min(beta, ttUtility));
+        if(ttBound == TT_LOWER && ttUtility >= beta)
+            return beta;
+        if(ttBound == TT_UPPER && ttUtility <= alpha)
+            return alpha;
     }
 
-    while(!orderedMoves.empty())
+    //without an action from a previous iteration a shallower search of this state
+    //provides one, so the full depth search does not start from history values
+    if(ttMove == 0 && depth >= IID_MIN_DEPTH)
     {
-        nextAction = orderedMoves.top();
-        currentUtility = ABmaxValue(s.result(nextAction, calcUtil, strategy, true, isOpening), depth-1, quiescentDepth, alpha, beta, isOpening);
+        ABminValue<Strategy>(s, depth - IID_REDUCTION, quiescentDepth, alpha, beta, ply);
+        if(searchAborted())
+            return beta;
+        tt->probe(s.hashKey, ttUtility, ttDepth, ttBound, ttMove);
+    }
+
+    s.actions(frame.moves);
+    orderMoves(frame.moves, ply, ttMove);
+    //the children compare their utility against this state's utility
+    if(calcUtil)
+        frame.staticEval = s.calculateUtility<Strategy>();
+
+    while(!frame.moves.empty())
+    {
+        //once the eldest brother is searched the rest can be shared with idle threads
+        if(pool != NULL && depth >= MIN_SPLIT_DEPTH && frame.moves.size() > 1 && eldestSearched)
+        {
+            if(splitSearch(s, frame.moves, false, depth, quiescentDepth, alpha, beta, calcUtil, ply, bestUtility, bestAction))
+            {
+                localStats->add(localStats->cutoffs);
+                updateHistoryTable(bestAction);
+                storeKiller(bestAction, ply);
+                if(!searchAborted())
+                    tt->store(s.hashKey, beta, depth, TT_UPPER, packMove(bestAction));
+                //Prune
+                return beta;
+            }
+            break;
+        }
+        nextAction = frame.moves.front();
+        s.resultInto<Strategy>(frame.child, nextAction, calcUtil, true, frame.staticEval,
+                               alpha, beta, lazyChange(quiescentDepth));
+        currentUtility = ABmaxValue<Strategy>(frame.child, depth-1, quiescentDepth, alpha, beta, ply+1);
         if(currentUtility < bestUtility)
         {
             bestUtility = currentUtility;
@@ -466,15 +1357,25 @@ int ai::ABminValue(state s, int depth, int quiescentDepth, int alpha, int beta,
         {
             //better move found, update upper bound
             beta = currentUtility;
+            updatePV(nextAction, ply);
         }
         if(beta <= alpha)
         {
+            localStats->add(localStats->cutoffs);
+            if(!eldestSearched)
+                localStats->add(localStats->firstMoveCutoffs);
             updateHistoryTable(nextAction);
+            storeKiller(nextAction, ply);
+            if(!searchAborted())
+                tt->store(s.hashKey, beta, depth, TT_UPPER, packMove(nextAction));
             //Prune
             return beta;
         }
-        orderedMoves.pop();
+        popMove(frame.moves);
+        eldestSearched = true;
     }
     updateHistoryTable(bestAction);
+    if(!searchAborted())
+        tt->store(s.hashKey, beta, depth, (beta < betaOrig) ? TT_EXACT : TT_LOWER, packMove(bestAction));
     return beta;
 }
@@ -8,6 +8,32 @@
 
 #include "game.h"
 #include "human.h"
+#include "transTable.h"
+#include "timeManager.h"
+#include "searchStats.h"
+#include "searchStack.h"
+#include "bitbase.h"
+#include "openingBook.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+
+class workPool;
+struct splitPoint;
+struct splitTask;
+
+//Parallel search modes used when an ai has more than one thread
+const int LAZY_SMP = 0;
+const int YBWC = 1;
+
+//A line of play found by the search: the principal variation starting with a root
+//action, the utility of the line and the depth it was searched to
+struct pvLine
+{
+    int depth = 0;
+    int utility = 0;
+    vector<action> pv;
+};
 
 //The ai class focuses on determining an optimal action through
 //analysis of game trees and the utility of their states
@@ -21,8 +47,122 @@ class ai
 		//This method encourages pruning because a move that was the best in the past
 		//is more likely to still be better than most in later searches creating
 		//more opportunities where alpha and beta values cross over.
-		static vector<action> ht;
+		//Each ai, and each helper thread of a parallel search, keeps its own table
+		vector<action> ht;
 		string htFile = "historyTable.txt";
+		//The table is carried from game to game in htFile unless persistHistory is cleared,
+		//as it is for players that share a directory while playing at the same time
+		bool persistHistory = true;
+
+		//Search stacks
+		//Preallocated frames holding the child state, actions, killer moves, utility and
+		//principal variation of every ply. stacks[0] belongs to this thread's search and
+		//a YBWC task nested inside another search uses the stack after the current one.
+		//The killer moves are two actions per ply that recently caused a cutoff at that
+		//ply. Sibling states usually share refutations, so these are searched right
+		//after the transposition table's best action.
+		vector<searchStack> stacks;
+		int stackIndex = 0;
+		//The principal variation of the last completed depth
+		vector<action> principalVariation;
+
+		//Multi-PV analysis
+		//With multiPV above 1, every depth searches the root again with the actions of
+		//the lines already found excluded, giving the best multiPV root actions with
+		//exact utilities. The transposition table is kept between the passes so the
+		//later passes cost much less than the first. pvLines holds the lines of the
+		//last completed depth, best first.
+		int multiPV = 1;
+		vector<pvLine> pvLines;
+		vector<action> excludedRootMoves;
+		//A packed action searched first at the root instead of the table's action
+		int rootOrderMove = 0;
+
+		//The depths of the search, the quiescence barrier, the time planned per move
+		//and the history table limits, which can be set at run time
+		searchParams params;
+
+		//Constants limiting the depth of the game tree searches
+		const int MAX_PLY = 64;
+		const int TT_SIZE_MB = 64;
+		//Internal iterative deepening searches states without a transposition table
+		//action at least IID_MIN_DEPTH from the horizon IID_REDUCTION shallower first
+		const int IID_MIN_DEPTH = 3;
+		const int IID_REDUCTION = 2;
+
+		//Search clock
+		//The clock is polled every NODE_CHECK_INTERVAL nodes (a power of two). No new
+		//depth is started after the time manager's soft limit and the search is abandoned
+		//after its hard limit, keeping the best action of the unfinished depth.
+		const int NODE_CHECK_INTERVAL = 256;
+		gameClock::time_point searchStart;
+		bool clockRunning = false;
+		int rootMovesSearched = 0;
+		int rootUtility = 0;
+		//Fixed move time, depth, or node limits. When none are set the game clock is used.
+		searchLimits limits;
+		//The limits of the search about to run and the time manager applying them
+		searchLimits turnLimits;
+		timeManager tm;
+
+		//Transposition table shared by every thread searching for this ai
+		shared_ptr<transTable> tt;
+
+		//Endgame bitbases shared by every thread. States they cover are not searched;
+		//a won or lost ending is worth BITBASE_WIN_VALUE plus the state's utility so the
+		//winning side still prefers the moves that make progress.
+		shared_ptr<bitbase> bitbases;
+		const int BITBASE_WIN_VALUE = 50000;
+		//Set when the root itself is covered, so only the search's leaves are looked up
+		bool bitbaseLeavesOnly = false;
+
+		//Opening book played from without a search while it knows the position.
+		//Book moves are drawn by weight when bookRandom is set, otherwise the
+		//heaviest move is played.
+		shared_ptr<openingBook> book;
+		bool bookRandom = true;
+
+		//Search statistics
+		//Every thread counts its nodes, transposition table probes and cutoffs in its
+		//own slot of stats. The totals are reported after every completed depth and
+		//printed as a line of JSON when printStats is set.
+		shared_ptr<searchStats> stats;
+		threadStats* localStats = NULL;
+		bool printStats = false;
+		//Prints the depth of each iteration as it starts
+		bool verbose = true;
+
+		//Number of threads used in a search. With more than one thread the ai runs
+		//a Lazy SMP search where helper threads run their own iterative deepening
+		//on their own copy of the board and share results through tt.
+		int numThreads = 1;
+		//Set on the copies of the ai that run as helper threads
+		bool isHelper = false;
+		//Signals helper threads to abandon their searches
+		shared_ptr<atomic<bool>> stopSearch;
+
+		//Selects Lazy SMP or the Young Brothers Wait tree splitting search
+		int parallelMode = LAZY_SMP;
+		//Nodes closer than this to the horizon are not split between threads
+		const int MIN_SPLIT_DEPTH = 2;
+		//The work-stealing pool of a YBWC search, this thread's index in it, and the
+		//split point of the task this thread is executing
+		workPool* pool = NULL;
+		int workerIndex = 0;
+		splitPoint* activeSplit = NULL;
+
+		//Pondering
+		//When enabled, the ai predicts the opponent's reply from the principal variation
+		//and searches the resulting state in a background thread during the opponent's turn.
+		bool ponderEnabled = false;
+		action ponderMove;
+		bool hasPonderMove = false;
+		bool isPondering = false;
+		state* ponderState = NULL;
+		action ponderResult;
+		shared_ptr<thread> ponderThread;
+		//Set when the opponent plays ponderMove so the ponder search starts using the clock
+		shared_ptr<atomic<bool>> ponderHit;
 
 		//strategy determines how the AI computes the utility of a state
 		//strategy 0 is a complex strategy including the safety of the king,
@@ -37,16 +177,34 @@ class ai
 
 		//Strategy 1 is simplistic but is able to be calculated with minimal overhead
 		//allowing deeper exploration of game trees in a given amount of time
+
+		//strategy 2 evaluates states with a neural network
+
+		//The search below the root is compiled for each strategy, so the strategy
+		//is only looked at where a search starts
 		int strategy;
 
 		//A reference to the game the AI is interacting with to obtain the current_state
 		//for creating a new game tree
 		game* target_game = NULL;
 
-		ai(int new_strategy, char historyTableIndex) {strategy = new_strategy; htFile.insert(htFile.begin()+12,historyTableIndex);}
+		ai(int new_strategy, char historyTableIndex, int threads = 1);
 
 		//Sets up the necessary variables to run the move selection algorithm and return its results
 		action runTurn();
+		//Forgets everything learned from previous searches
+		void newGame();
+		action search(state& s, gameClock::time_point startTime);
+		searchLimits gameLimits(int rankDirection, int turnsAhead);
+		//Returns the statistics of the last completed depth or of every depth of the last search
+		searchReport lastSearchReport();
+		vector<searchReport>& searchReports();
+
+		//Functions for searching on the opponent's time
+		bool findPonderMove(state& s, action& a);
+		void startPondering();
+		void stopPondering();
+		void ponderSearch();
 
 		//Helper functions for interacting with the history table and its values
 		void initializeHistoryTable();
@@ -64,17 +222,55 @@ class ai
         //response. This avoids letting a trap be set to trick the AI into starting down an overall
         //bad path to get a nearby reward.
         bool isNonquiescent(state& s);
+        int lazyChange(int quiescentDepth);
 
         //Functions helping the AI relate how long it is taking to make moves and what depth of
         //game tree can it observe without over using its time allowance
-        double timeHeuristic(state& s, clock_t startTime, double timeRemaining, bool isOpening);
-        bool canCompleteNextDepth(state& s, clock_t startTime, double timeRemaining,  double endTime);
+        bool canCompleteNextDepth(state& s, gameClock::time_point startTime, double allowance);
+        bool isEasyMove(state& s, action& best, int depth);
+        void countNode(int depth, int quiescentDepth, int ply);
+        void checkTime();
+
+        //Runs IDABminimax on this thread while numThreads-1 helper threads search
+        //the same state and fill the shared transposition table
+        action lazySMPSearch(state& s, gameClock::time_point startTime);
+        void helperSearch(state& s, int helperIndex);
+
+        //Young Brothers Wait search. Once the eldest brother at a node is searched the
+        //remaining actions become tasks that idle threads of the pool can steal.
+        action ybwcSearch(state& s, gameClock::time_point startTime);
+        bool splitSearch(state& s, vector<action>& orderedMoves, bool isMaxNode, int depth, int quiescentDepth,
+                         int& alpha, int& beta, bool calcUtil, int ply, int& bestUtility, action& bestAction);
+        void executeTask(splitTask& task);
+        void workerLoop();
+        bool searchAborted();
+
+        //Functions for ordering actions and packing them into transposition table entries
+        void orderMoves(vector<action>& possibleMoves, int ply, int ttMove);
+        void popMove(vector<action>& possibleMoves);
+        void storeKiller(action& a, int ply);
+        void updatePV(action& a, int ply);
+        int packMove(action& a);
+        bool probeTable(unsigned long long key, int& utility, int& depth, int& bound, int& move);
+        bool probeBitbase(state& s, int& utility);
+        void keepBitbaseResult(state& s, searchFrame& frame, int result);
+        int bitbaseProgress(state& s, myPlayer* winner);
 
         //The primary move selection algorithm and its recursive sub-functions
-        action IDABminimax(state& s, clock_t startTime, bool isOpening);
-        action ABminimax(state& s, int depth, int quiescentDepth, bool isOpening);
-        int ABmaxValue(state s, int depth, int quiescentDepth, int alpha, int beta, bool isOpening);
-        int ABminValue(state s, int depth, int quiescentDepth, int alpha, int beta, bool isOpening);
+        action IDABminimax(state& s, gameClock::time_point startTime);
+        action ABminimax(state& s, int depth, int quiescentDepth);
+        template <int Strategy>
+        action ABminimax(state& s, int depth, int quiescentDepth);
+        bool searchPVLines(state& s, action& best, int depth);
+        void printPVLines();
+        string moveText(action& a);
+        //Searches child, a state reached from a max node if isMaxNode is set, with the
+        //version of the search compiled for the ai's strategy
+        int searchChild(state& child, bool isMaxNode, int depth, int quiescentDepth, int alpha, int beta, int ply);
+        template <int Strategy>
+        int ABmaxValue(state& s, int depth, int quiescentDepth, int alpha, int beta, int ply);
+        template <int Strategy>
+        int ABminValue(state& s, int depth, int quiescentDepth, int alpha, int beta, int ply);
 };
 
 #endif /* AI_H_ */
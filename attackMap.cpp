@@ -0,0 +1,203 @@
+/*
+ * attackMap.cpp
+ * This file contains the function implementations for the attackMap class.
+ */
+
+#include "attackMap.h"
+#include "game.h"
+
+using namespace std;
+
+unsigned long long attackMap::knightTable[64];
+unsigned long long attackMap::kingTable[64];
+unsigned long long attackMap::pawnAttackTable[2][64];
+bool attackMap::tablesReady = attackMap::initializeTables();
+
+//Returns the bit of the square rank, file counted from 0, or 0 off the board
+static unsigned long long boardBit(int rank, int file)
+{
+    if(rank < 0 || rank > 7 || file < 0 || file > 7)
+        return 0;
+    return 1ULL << (rank * 8 + file);
+}
+
+//Fills in the attacks of the pieces that do not slide
+bool attackMap::initializeTables()
+{
+    const int KNIGHT_STEPS[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+    const int KING_STEPS[8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+
+    for(int square = 0; square < 64; square++)
+    {
+        int rank = square / 8;
+        int file = square % 8;
+        knightTable[square] = 0;
+        kingTable[square] = 0;
+        for(int i = 0; i < 8; i++)
+        {
+            knightTable[square] |= boardBit(rank + KNIGHT_STEPS[i][0], file + KNIGHT_STEPS[i][1]);
+            kingTable[square] |= boardBit(rank + KING_STEPS[i][0], file + KING_STEPS[i][1]);
+        }
+        pawnAttackTable[0][square] = boardBit(rank + 1, file - 1) | boardBit(rank + 1, file + 1);
+        pawnAttackTable[1][square] = boardBit(rank - 1, file - 1) | boardBit(rank - 1, file + 1);
+    }
+    return true;
+}
+
+unsigned long long attackMap::knightAttacks(int square)
+{
+    return knightTable[square];
+}
+
+unsigned long long attackMap::kingAttacks(int square)
+{
+    return kingTable[square];
+}
+
+unsigned long long attackMap::pawnAttacks(int color, int square)
+{
+    return pawnAttackTable[color][square];
+}
+
+//Returns the squares reached from square moving along the four directions
+static unsigned long long slide(int square, unsigned long long occupancy, const int directions[4][2])
+{
+    unsigned long long result = 0;
+    for(int i = 0; i < 4; i++)
+    {
+        int rank = square / 8 + directions[i][0];
+        int file = square % 8 + directions[i][1];
+        unsigned long long bit;
+        while((bit = boardBit(rank, file)) != 0)
+        {
+            result |= bit;
+            if(occupancy & bit)
+                break;
+            rank += directions[i][0];
+            file += directions[i][1];
+        }
+    }
+    return result;
+}
+
+unsigned long long attackMap::bishopAttacks(int square, unsigned long long occupancy)
+{
+    const int DIAGONALS[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+    return slide(square, occupancy, DIAGONALS);
+}
+
+unsigned long long attackMap::rookAttacks(int square, unsigned long long occupancy)
+{
+    const int LINES[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    return slide(square, occupancy, LINES);
+}
+
+unsigned long long attackMap::pieceAttacks(int color, int type, int square, unsigned long long occupancy)
+{
+    switch(type)
+    {
+        case 0:
+            return pawnAttackTable[color][square];
+        case 1:
+            return knightTable[square];
+        case 2:
+            return bishopAttacks(square, occupancy);
+        case 3:
+            return rookAttacks(square, occupancy);
+        case 4:
+            return bishopAttacks(square, occupancy) | rookAttacks(square, occupancy);
+        default:
+            return kingTable[square];
+    }
+}
+
+//Collects the pieces of s, then walks every piece once to gather its attacks, its
+//mobility, and whether it reaches the opponent's king zone. The pawns of both
+//colors go first since the mobility of the other pieces depends on them.
+void attackMap::build(state& s)
+{
+    //How much a knight, bishop, rook or queen attacking a king zone adds to its danger
+    const int ATTACK_WEIGHTS[6] = {0, 2, 2, 3, 5, 0};
+
+    all = 0;
+    for(int color = 0; color < 2; color++)
+    {
+        occupied[color] = 0;
+        attacked[color] = 0;
+        attackedTwice[color] = 0;
+        kingSquare[color] = -1;
+        kingZone[color] = 0;
+        kingAttackers[color] = 0;
+        kingAttackWeight[color] = 0;
+        kingZoneHits[color] = 0;
+        for(int type = 0; type < 6; type++)
+        {
+            pieces[color][type] = 0;
+            attacks[color][type] = 0;
+            mobility[color][type] = 0;
+        }
+    }
+
+    for(unsigned int p = 0; p < s.players.size(); p++)
+    {
+        int color = (s.players[p]->rankDirection == 1) ? 0 : 1;
+        for(unsigned int i = 0; i < s.players[p]->pieces.size(); i++)
+        {
+            myPiece* piece = s.players[p]->pieces[i];
+            int type = s.pieceIndex(piece->type);
+            int square = s.squareIndex(piece->rank, piece->file);
+            pieces[color][type] |= 1ULL << square;
+            occupied[color] |= 1ULL << square;
+            if(type == 5)
+                kingSquare[color] = square;
+        }
+    }
+    all = occupied[0] | occupied[1];
+
+    for(int color = 0; color < 2; color++)
+    {
+        if(kingSquare[color] < 0)
+            continue;
+        unsigned long long zone = kingTable[kingSquare[color]] | (1ULL << kingSquare[color]);
+        kingZone[color] = zone | ((color == 0) ? zone << 8 : zone >> 8);
+    }
+
+    for(int color = 0; color < 2; color++)
+    {
+        unsigned long long remaining = pieces[color][0];
+        while(remaining)
+        {
+            int square = __builtin_ctzll(remaining);
+            remaining &= remaining - 1;
+            attackedTwice[color] |= attacked[color] & pawnAttackTable[color][square];
+            attacked[color] |= pawnAttackTable[color][square];
+        }
+        attacks[color][0] = attacked[color];
+    }
+
+    for(int color = 0; color < 2; color++)
+    {
+        unsigned long long enemyZone = kingZone[1 - color];
+        unsigned long long mobilityArea = ~occupied[color] & ~attacks[1 - color][0];
+        for(int type = 1; type < 6; type++)
+        {
+            unsigned long long remaining = pieces[color][type];
+            while(remaining)
+            {
+                int square = __builtin_ctzll(remaining);
+                remaining &= remaining - 1;
+                unsigned long long reach = pieceAttacks(color, type, square, all);
+                attackedTwice[color] |= attacked[color] & reach;
+                attacked[color] |= reach;
+                attacks[color][type] |= reach;
+                mobility[color][type] += count(reach & mobilityArea);
+                if(ATTACK_WEIGHTS[type] > 0 && (reach & enemyZone))
+                {
+                    kingAttackers[1 - color]++;
+                    kingAttackWeight[1 - color] += ATTACK_WEIGHTS[type];
+                    kingZoneHits[1 - color] += count(reach & enemyZone);
+                }
+            }
+        }
+    }
+}
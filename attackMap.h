@@ -0,0 +1,70 @@
+/*
+ * attackMap.h
+ * This file contains the header information for the attackMap class, which holds
+ * the squares each side's pieces attack as 64 bit boards.
+ */
+
+#ifndef ATTACKMAP_H_
+#define ATTACKMAP_H_
+
+using namespace std;
+
+class state;
+
+//The attackMap class describes the pieces of a state and the squares they attack
+//as bitboards, bit 0 being a1 and bit 63 h8 as in state::squareIndex(). It is
+//built once per evaluation so every term asking which squares are attacked or
+//defended gets its answer from a few bit operations instead of searching the
+//board. Arrays indexed by color hold white's boards at 0 and black's at 1, and
+//piece types are numbered as in state::pieceIndex().
+class attackMap
+{
+    public:
+        //Pieces of each color by type, all pieces of each color, and every piece
+        unsigned long long pieces[2][6];
+        unsigned long long occupied[2];
+        unsigned long long all;
+        //Squares attacked by each color's pieces of each type, by any of its pieces,
+        //and by at least two of them
+        unsigned long long attacks[2][6];
+        unsigned long long attacked[2];
+        unsigned long long attackedTwice[2];
+
+        //Each color's king square, -1 without a king, and the zone around it: the
+        //squares next to the king and the rank in front of those
+        int kingSquare[2];
+        unsigned long long kingZone[2];
+        //The number of the opponent's knights, bishops, rooks and queens attacking the
+        //color's king zone, the sum of their attack weights, and the zone squares they hit
+        int kingAttackers[2];
+        int kingAttackWeight[2];
+        int kingZoneHits[2];
+        //The squares each color's pieces of each type can go to without landing on a
+        //piece of their own or a square an enemy pawn attacks, summed over the pieces
+        int mobility[2][6];
+
+        void build(state& s);
+
+        //Attacks of a piece standing on square. Sliding pieces stop at the first
+        //piece of occupancy in each direction, which is included.
+        static unsigned long long knightAttacks(int square);
+        static unsigned long long kingAttacks(int square);
+        static unsigned long long pawnAttacks(int color, int square);
+        static unsigned long long bishopAttacks(int square, unsigned long long occupancy);
+        static unsigned long long rookAttacks(int square, unsigned long long occupancy);
+        static unsigned long long pieceAttacks(int color, int type, int square, unsigned long long occupancy);
+
+        //Returns the number of set bits
+        static int count(unsigned long long bits) {return __builtin_popcountll(bits);}
+
+    private:
+        static unsigned long long knightTable[64];
+        static unsigned long long kingTable[64];
+        static unsigned long long pawnAttackTable[2][64];
+        //Set once the tables are filled in at program start
+        static bool tablesReady;
+
+        static bool initializeTables();
+};
+
+#endif /* ATTACKMAP_H_ */
@@ -0,0 +1,17 @@
+/*
+ * bench.h
+ * This file contains the header information for the bench command, a fixed
+ * depth search over a built-in set of positions used to measure the speed of
+ * the ai and to check that a change leaves its search unchanged.
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+//Searches every bench position to depth with a transposition table of hashMB
+//megabytes and prints the nodes, time and nodes per second. With a single thread
+//the total node count is a signature of the search's behaviour.
+//Returns 0 on success or 1 if a position could not be loaded.
+int runBench(int depth, int hashMB, int threads, int parallelMode, int strategy);
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,823 @@
+/*
+ * bitbase.cpp
+ * This file contains the function implementations for the bitbase class along with
+ * the move generation of the small positions its tables are built from.
+ */
+
+#include "bitbase.h"
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const int PAWN = 0;
+static const int KNIGHT = 1;
+static const int BISHOP = 2;
+static const int ROOK = 3;
+static const int QUEEN = 4;
+static const int KING = 5;
+static const char PIECE_LETTERS[] = "PNBRQK";
+static const int PIECE_STRENGTH[6] = {1, 3, 3, 5, 9, 0};
+//The most pieces besides the king either side has in a table
+static const int MAX_SIDE_PIECES = bitbase::MAX_PIECES - 2;
+
+//Table files start with the magic bytes, the number of pieces and the number of positions
+static const char FILE_MAGIC[4] = {'C', 'B', 'B', '1'};
+static const int HEADER_SIZE = 16;
+//Result of a position the generator has not decided yet
+static const unsigned char UNDECIDED = 4;
+
+//The a1-d1-d4 triangle white's king is kept in by the tables without pawns
+static const int TRIANGLE_SQUARES[10] = {0, 1, 2, 3, 9, 10, 11, 18, 19, 27};
+
+//File and rank steps of the king, where the even entries are the rook directions
+//and the odd entries the bishop directions, and of the knight
+static const int KING_STEPS[8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+static const int KNIGHT_STEPS[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+
+static int triangleSlot(int square)
+{
+    for(int i = 0; i < 10; i++)
+    {
+        if(TRIANGLE_SQUARES[i] == square)
+            return i;
+    }
+    return 0;
+}
+
+static unsigned long long tableSize(int numPieces, bool hasPawns)
+{
+    unsigned long long size = hasPawns ? 32 : 10;
+    for(int i = 1; i < numPieces; i++)
+        size *= 64;
+    return size * 2;
+}
+
+//Mirrors the board along the a1-h8 diagonal
+static void transpose(bbPosition& p)
+{
+    for(int i = 0; i < p.numPieces; i++)
+        p.square[i] = (p.square[i] % 8) * 8 + p.square[i] / 8;
+}
+
+//Mirrors the board until white's king, the first piece of p, is on files a to d and,
+//without pawns, inside the a1-d1-d4 triangle
+static void normalizeSquares(bbPosition& p, bool hasPawns)
+{
+    if(p.square[0] % 8 > 3)
+    {
+        for(int i = 0; i < p.numPieces; i++)
+            p.square[i] ^= 7;
+    }
+    if(!hasPawns)
+    {
+        if(p.square[0] / 8 > 3)
+        {
+            for(int i = 0; i < p.numPieces; i++)
+                p.square[i] ^= 56;
+        }
+        if(p.square[0] / 8 > p.square[0] % 8)
+            transpose(p);
+    }
+}
+
+//Orders the pieces of p the way its table stores them and returns the table's
+//signature. The side with more material becomes white, the kings come first and
+//each side's other pieces follow strongest first before the board is normalized.
+static string canonicalize(bbPosition& p)
+{
+    int sideTypes[2][MAX_SIDE_PIECES];
+    int numTypes[2] = {0, 0};
+    int sideKey[2] = {0, 0};
+    bool hasPawns = false;
+
+    for(int i = 0; i < p.numPieces; i++)
+    {
+        if(p.type[i] == PAWN)
+            hasPawns = true;
+        if(p.type[i] != KING)
+            sideTypes[p.color[i]][numTypes[p.color[i]]++] = p.type[i];
+    }
+    //sides compare by material and then by their strongest pieces
+    for(int side = 0; side < 2; side++)
+    {
+        int digits = 0;
+        for(int t = QUEEN; t >= PAWN; t--)
+        {
+            for(int i = 0; i < numTypes[side]; i++)
+            {
+                if(sideTypes[side][i] == t)
+                {
+                    sideKey[side] += PIECE_STRENGTH[t] * 100;
+                    digits = digits * 10 + t + 1;
+                }
+            }
+        }
+        for(int i = numTypes[side]; i < MAX_SIDE_PIECES; i++)
+            digits *= 10;
+        sideKey[side] += digits;
+    }
+    int flip = (sideKey[1] > sideKey[0]) ? 1 : 0;
+
+    string signature;
+    for(int side = 0; side < 2; side++)
+    {
+        signature += PIECE_LETTERS[KING];
+        for(int t = QUEEN; t >= PAWN; t--)
+        {
+            for(int i = 0; i < p.numPieces; i++)
+            {
+                if(p.type[i] == t && (p.color[i] ^ flip) == side)
+                    signature += PIECE_LETTERS[t];
+            }
+        }
+    }
+
+    bbPosition c;
+    c.numPieces = p.numPieces;
+    c.sideToMove = p.sideToMove ^ flip;
+    //place the kings and then the other pieces in signature order
+    int n = 0;
+    for(int side = 0; side < 2; side++)
+    {
+        for(int i = 0; i < p.numPieces; i++)
+        {
+            if(p.type[i] == KING && (p.color[i] ^ flip) == side)
+            {
+                c.type[n] = KING;
+                c.color[n] = side;
+                c.square[n++] = flip ? p.square[i] ^ 56 : p.square[i];
+            }
+        }
+    }
+    for(int side = 0; side < 2; side++)
+    {
+        for(int t = QUEEN; t >= PAWN; t--)
+        {
+            for(int i = 0; i < p.numPieces; i++)
+            {
+                if(p.type[i] == t && (p.color[i] ^ flip) == side)
+                {
+                    c.type[n] = t;
+                    c.color[n] = side;
+                    c.square[n++] = flip ? p.square[i] ^ 56 : p.square[i];
+                }
+            }
+        }
+    }
+
+    normalizeSquares(c, hasPawns);
+    p = c;
+    return signature;
+}
+
+static unsigned long long positionIndex(const bbPosition& p, bool hasPawns)
+{
+    unsigned long long index = hasPawns ? (p.square[0] / 8) * 4 + p.square[0] % 8 : triangleSlot(p.square[0]);
+    for(int i = 1; i < p.numPieces; i++)
+        index = index * 64 + p.square[i];
+    return index * 2 + p.sideToMove;
+}
+
+//Sets the squares and player to move of p, whose pieces are already in table order,
+//from a table index
+static void decodeIndex(bbPosition& p, unsigned long long index, bool hasPawns)
+{
+    p.sideToMove = index % 2;
+    index /= 2;
+    for(int i = p.numPieces - 1; i > 0; i--)
+    {
+        p.square[i] = index % 64;
+        index /= 64;
+    }
+    p.square[0] = hasPawns ? (index / 4) * 8 + index % 4 : TRIANGLE_SQUARES[index];
+}
+
+//Returns a position holding the pieces of signature in table order, or a position
+//without pieces if signature is not an ending of three or four pieces
+static bbPosition signaturePosition(const string& signature)
+{
+    bbPosition p;
+    size_t secondKing = signature.find('K', 1);
+    if(signature.size() < 3 || (int)signature.size() > bitbase::MAX_PIECES || signature[0] != 'K' ||
+       secondKing == string::npos)
+    {
+        return p;
+    }
+    for(unsigned int i = 0; i < signature.size(); i++)
+    {
+        const char* letter = strchr(PIECE_LETTERS, signature[i]);
+        if(letter == NULL || signature[i] == '\0' || (signature[i] == 'K' && i != 0 && i != secondKing))
+        {
+            p.numPieces = 0;
+            return p;
+        }
+        p.type[i] = letter - PIECE_LETTERS;
+        p.color[i] = (i < secondKing) ? 0 : 1;
+        p.square[i] = i;
+        p.numPieces++;
+    }
+    canonicalize(p);
+    return p;
+}
+
+//Returns true if the piece at index i of p attacks target, where occupied holds
+//the squares of every piece
+static bool attacks(const bbPosition& p, int i, int target, unsigned long long occupied)
+{
+    int from = p.square[i];
+    int df = target % 8 - from % 8;
+    int dr = target / 8 - from / 8;
+    int adf = abs(df);
+    int adr = abs(dr);
+    if(from == target)
+        return false;
+
+    switch(p.type[i])
+    {
+        case PAWN:
+            return adf == 1 && dr == ((p.color[i] == 0) ? 1 : -1);
+        case KNIGHT:
+            return (adf == 1 && adr == 2) || (adf == 2 && adr == 1);
+        case KING:
+            return adf <= 1 && adr <= 1;
+        case QUEEN:
+            if(adf != adr && df != 0 && dr != 0)
+                return false;
+            break;
+        default:
+            //bishops move along diagonals and rooks along ranks and files
+            if((p.type[i] == BISHOP) != (adf == adr) || (p.type[i] == ROOK && df != 0 && dr != 0))
+                return false;
+    }
+
+    int step = ((dr > 0) ? 8 : (dr < 0) ? -8 : 0) + ((df > 0) ? 1 : (df < 0) ? -1 : 0);
+    for(int square = from + step; square != target; square += step)
+    {
+        if((occupied >> square) & 1)
+            return false;
+    }
+    return true;
+}
+
+//Returns true if a piece of byColor attacks target
+static bool attacked(const bbPosition& p, int target, int byColor)
+{
+    unsigned long long occupied = 0;
+    for(int i = 0; i < p.numPieces; i++)
+        occupied |= 1ULL << p.square[i];
+    for(int i = 0; i < p.numPieces; i++)
+    {
+        if(p.color[i] == byColor && attacks(p, i, target, occupied))
+            return true;
+    }
+    return false;
+}
+
+static int kingSquare(const bbPosition& p, int color)
+{
+    for(int i = 0; i < p.numPieces; i++)
+    {
+        if(p.type[i] == KING && p.color[i] == color)
+            return p.square[i];
+    }
+    return 0;
+}
+
+//Returns true if p could come up in a game with its player to move
+static bool isValid(const bbPosition& p)
+{
+    for(int i = 0; i < p.numPieces; i++)
+    {
+        if(p.type[i] == PAWN && (p.square[i] / 8 == 0 || p.square[i] / 8 == 7))
+            return false;
+        for(int j = 0; j < i; j++)
+        {
+            if(p.square[i] == p.square[j])
+                return false;
+        }
+    }
+    return !attacked(p, kingSquare(p, p.sideToMove ^ 1), p.sideToMove);
+}
+
+//Adds the position after the piece at index i of p moves to target, becoming a
+//promotion piece unless promotion is -1, if the move does not leave its own king in check
+static void addMove(const bbPosition& p, int i, int target, int promotion, vector<bbPosition>& children)
+{
+    bbPosition c;
+    c.sideToMove = p.sideToMove ^ 1;
+    for(int j = 0; j < p.numPieces; j++)
+    {
+        //a piece on the target square is captured
+        if(j != i && p.square[j] == target)
+            continue;
+        c.type[c.numPieces] = (j == i && promotion != -1) ? promotion : p.type[j];
+        c.color[c.numPieces] = p.color[j];
+        c.square[c.numPieces] = (j == i) ? target : p.square[j];
+        c.numPieces++;
+    }
+    if(!attacked(c, kingSquare(c, p.sideToMove), c.sideToMove))
+        children.push_back(c);
+}
+
+//Fills children with the position after every legal move of the player to move.
+//Castling and en passant never come up in the tables.
+static void generateMoves(const bbPosition& p, vector<bbPosition>& children)
+{
+    unsigned long long occupied = 0;
+    unsigned long long own = 0;
+    children.clear();
+    for(int i = 0; i < p.numPieces; i++)
+    {
+        occupied |= 1ULL << p.square[i];
+        if(p.color[i] == p.sideToMove)
+            own |= 1ULL << p.square[i];
+    }
+
+    for(int i = 0; i < p.numPieces; i++)
+    {
+        if(p.color[i] != p.sideToMove)
+            continue;
+        int file = p.square[i] % 8;
+        int rank = p.square[i] / 8;
+        int type = p.type[i];
+
+        if(type == KING || type == KNIGHT)
+        {
+            const int (*steps)[2] = (type == KING) ? KING_STEPS : KNIGHT_STEPS;
+            for(int d = 0; d < 8; d++)
+            {
+                int f = file + steps[d][0];
+                int r = rank + steps[d][1];
+                if(f < 0 || f > 7 || r < 0 || r > 7 || ((own >> (r * 8 + f)) & 1))
+                    continue;
+                addMove(p, i, r * 8 + f, -1, children);
+            }
+        }
+        else if(type == PAWN)
+        {
+            int direction = (p.color[i] == 0) ? 1 : -1;
+            int startRank = (p.color[i] == 0) ? 1 : 6;
+            int lastRank = (p.color[i] == 0) ? 7 : 0;
+            int targets[4];
+            int numTargets = 0;
+            int forward = p.square[i] + 8 * direction;
+            if(!((occupied >> forward) & 1))
+            {
+                targets[numTargets++] = forward;
+                if(rank == startRank && !((occupied >> (forward + 8 * direction)) & 1))
+                    targets[numTargets++] = forward + 8 * direction;
+            }
+            for(int df = -1; df <= 1; df += 2)
+            {
+                if(file + df < 0 || file + df > 7)
+                    continue;
+                int target = forward + df;
+                if(((occupied & ~own) >> target) & 1)
+                    targets[numTargets++] = target;
+            }
+            for(int t = 0; t < numTargets; t++)
+            {
+                if(targets[t] / 8 == lastRank)
+                {
+                    for(int promotion = QUEEN; promotion > PAWN; promotion--)
+                        addMove(p, i, targets[t], promotion, children);
+                }
+                else
+                {
+                    addMove(p, i, targets[t], -1, children);
+                }
+            }
+        }
+        else
+        {
+            for(int d = 0; d < 8; d++)
+            {
+                //rooks slide along the even directions and bishops the odd ones
+                if(type != QUEEN && (type == ROOK) != (d % 2 == 0))
+                    continue;
+                int f = file + KING_STEPS[d][0];
+                int r = rank + KING_STEPS[d][1];
+                while(f >= 0 && f <= 7 && r >= 0 && r <= 7 && !((own >> (r * 8 + f)) & 1))
+                {
+                    addMove(p, i, r * 8 + f, -1, children);
+                    if((occupied >> (r * 8 + f)) & 1)
+                        break;
+                    f += KING_STEPS[d][0];
+                    r += KING_STEPS[d][1];
+                }
+            }
+        }
+    }
+}
+
+//Fills parents with every position of the same table that has a move to p. The
+//player who is not to move in p takes back a move that captured nothing.
+static void generateUnmoves(const bbPosition& p, vector<bbPosition>& parents)
+{
+    unsigned long long occupied = 0;
+    int mover = p.sideToMove ^ 1;
+    parents.clear();
+    for(int i = 0; i < p.numPieces; i++)
+        occupied |= 1ULL << p.square[i];
+
+    bbPosition parent = p;
+    parent.sideToMove = mover;
+    for(int i = 0; i < p.numPieces; i++)
+    {
+        if(p.color[i] != mover)
+            continue;
+        int file = p.square[i] % 8;
+        int rank = p.square[i] / 8;
+        int type = p.type[i];
+        int origins[28];
+        int numOrigins = 0;
+
+        if(type == KING || type == KNIGHT)
+        {
+            const int (*steps)[2] = (type == KING) ? KING_STEPS : KNIGHT_STEPS;
+            for(int d = 0; d < 8; d++)
+            {
+                int f = file + steps[d][0];
+                int r = rank + steps[d][1];
+                if(f >= 0 && f <= 7 && r >= 0 && r <= 7 && !((occupied >> (r * 8 + f)) & 1))
+                    origins[numOrigins++] = r * 8 + f;
+            }
+        }
+        else if(type == PAWN)
+        {
+            //pawns step back towards their own side, two squares from the fourth rank
+            int direction = (mover == 0) ? -1 : 1;
+            int doubleRank = (mover == 0) ? 3 : 4;
+            int back = p.square[i] + 8 * direction;
+            int backRank = back / 8;
+            if(backRank >= 1 && backRank <= 6 && !((occupied >> back) & 1))
+            {
+                origins[numOrigins++] = back;
+                if(rank == doubleRank && !((occupied >> (back + 8 * direction)) & 1))
+                    origins[numOrigins++] = back + 8 * direction;
+            }
+        }
+        else
+        {
+            for(int d = 0; d < 8; d++)
+            {
+                if(type != QUEEN && (type == ROOK) != (d % 2 == 0))
+                    continue;
+                int f = file + KING_STEPS[d][0];
+                int r = rank + KING_STEPS[d][1];
+                while(f >= 0 && f <= 7 && r >= 0 && r <= 7 && !((occupied >> (r * 8 + f)) & 1))
+                {
+                    origins[numOrigins++] = r * 8 + f;
+                    f += KING_STEPS[d][0];
+                    r += KING_STEPS[d][1];
+                }
+            }
+        }
+
+        for(int o = 0; o < numOrigins; o++)
+        {
+            parent.square[i] = origins[o];
+            if(isValid(parent))
+                parents.push_back(parent);
+        }
+        parent.square[i] = p.square[i];
+    }
+}
+
+//Sets indexes to the table indexes of p, a position of the table in table order,
+//and returns how many there are. Without pawns a white king on the a1-h8 diagonal
+//leaves two ways to place the other pieces, both stored in the table.
+static int tableIndexes(bbPosition& p, bool hasPawns, unsigned long long indexes[2])
+{
+    normalizeSquares(p, hasPawns);
+    indexes[0] = positionIndex(p, hasPawns);
+    if(hasPawns || p.square[0] / 8 != p.square[0] % 8)
+        return 1;
+    transpose(p);
+    indexes[1] = positionIndex(p, hasPawns);
+    return (indexes[1] == indexes[0]) ? 1 : 2;
+}
+
+//Returns the signature of the table holding the pieces of p except the piece at
+//index removed, which becomes a promotion piece instead unless promotion is -1
+static string relatedSignature(const bbPosition& p, int index, int promotion)
+{
+    bbPosition related;
+    for(int i = 0; i < p.numPieces; i++)
+    {
+        if(i == index && promotion == -1)
+            continue;
+        related.type[related.numPieces] = (i == index) ? promotion : p.type[i];
+        related.color[related.numPieces] = p.color[i];
+        related.square[related.numPieces] = i;
+        related.numPieces++;
+    }
+    return canonicalize(related);
+}
+
+//Returns every ending of three and four pieces
+static vector<string> allSignatures()
+{
+    const string letters = "QRBNP";
+    vector<string> signatures;
+    for(unsigned int a = 0; a < letters.size(); a++)
+        signatures.push_back("K" + letters.substr(a, 1) + "K");
+    for(unsigned int a = 0; a < letters.size(); a++)
+    {
+        for(unsigned int b = a; b < letters.size(); b++)
+        {
+            signatures.push_back("K" + letters.substr(a, 1) + letters.substr(b, 1) + "K");
+            signatures.push_back("K" + letters.substr(a, 1) + "K" + letters.substr(b, 1));
+        }
+    }
+    return signatures;
+}
+
+bitbase::~bitbase()
+{
+    for(map<string, bitbaseTable>::iterator it = tables.begin(); it != tables.end(); ++it)
+        munmap(it->second.mapping, it->second.mappingSize);
+}
+
+int bitbase::load(const string& dir)
+{
+    directory = dir;
+    vector<string> signatures = allSignatures();
+    for(unsigned int i = 0; i < signatures.size(); i++)
+    {
+        if(tables.count(signatures[i]) == 0)
+            mapTable(signatures[i]);
+    }
+    return tables.size();
+}
+
+bool bitbase::isLoaded()
+{
+    return !tables.empty();
+}
+
+//Castling rights and en passant captures are not part of the tables, so states
+//where either could be played are left to the search
+int bitbase::probe(state& s)
+{
+    if(tables.empty() || s.castlingRights != 0 ||
+       s.players[0]->pieces.size() + s.players[1]->pieces.size() > (unsigned int)MAX_PIECES)
+    {
+        return BITBASE_UNKNOWN;
+    }
+
+    bbPosition p;
+    bool moverHasPawn = false;
+    p.sideToMove = (s.currentPlayer->rankDirection == 1) ? 0 : 1;
+    for(unsigned int i = 0; i < s.players.size(); i++)
+    {
+        int color = (s.players[i]->rankDirection == 1) ? 0 : 1;
+        for(unsigned int j = 0; j < s.players[i]->pieces.size(); j++)
+        {
+            myPiece* piece = s.players[i]->pieces[j];
+            p.type[p.numPieces] = s.pieceIndex(piece->type);
+            p.color[p.numPieces] = color;
+            p.square[p.numPieces] = s.squareIndex(piece->rank, piece->file);
+            if(p.type[p.numPieces] == PAWN && color == p.sideToMove)
+                moverHasPawn = true;
+            p.numPieces++;
+        }
+    }
+    if(moverHasPawn && s.enPassantFile() != 0)
+        return BITBASE_UNKNOWN;
+    return probe(p);
+}
+
+int bitbase::probe(bbPosition& p)
+{
+    if(p.numPieces == 2)
+        return BITBASE_DRAW;
+    map<string, bitbaseTable>::iterator it = tables.find(canonicalize(p));
+    if(it == tables.end())
+        return BITBASE_UNKNOWN;
+    return tableResult(it->second, positionIndex(p, it->second.hasPawns));
+}
+
+int bitbase::tableResult(const bitbaseTable& table, unsigned long long index)
+{
+    return (table.data[index >> 2] >> ((index & 3) * 2)) & 3;
+}
+
+//Maps the file of a table and checks its header
+bool bitbase::mapTable(const string& signature)
+{
+    string path = directory + "/" + signature + ".bb";
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size < HEADER_SIZE)
+    {
+        close(fd);
+        return false;
+    }
+    void* mapping = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED)
+        return false;
+
+    bitbaseTable table;
+    table.hasPawns = signature.find('P') != string::npos;
+    table.numPositions = tableSize(signature.size(), table.hasPawns);
+    table.mapping = mapping;
+    table.mappingSize = info.st_size;
+    table.data = (const unsigned char*)mapping + HEADER_SIZE;
+
+    unsigned long long storedPositions;
+    memcpy(&storedPositions, (const char*)mapping + 8, sizeof(storedPositions));
+    if(memcmp(mapping, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || storedPositions != table.numPositions ||
+       (unsigned long long)info.st_size < HEADER_SIZE + (table.numPositions + 3) / 4)
+    {
+        cerr << "Ignoring damaged bitbase " << path << endl;
+        munmap(mapping, info.st_size);
+        return false;
+    }
+    tables[signature] = table;
+    return true;
+}
+
+bool bitbase::generate(const string& dir, vector<string> signatures)
+{
+    directory = dir;
+    mkdir(dir.c_str(), 0755);
+    if(signatures.empty())
+        signatures = allSignatures();
+
+    for(unsigned int i = 0; i < signatures.size(); i++)
+    {
+        for(unsigned int j = 0; j < signatures[i].size(); j++)
+            signatures[i][j] = toupper(signatures[i][j]);
+        bbPosition p = signaturePosition(signatures[i]);
+        if(p.numPieces == 0)
+        {
+            cerr << "Not an ending of three or four pieces: " << signatures[i] << endl;
+            return false;
+        }
+        if(!build(canonicalize(p)))
+            return false;
+    }
+    return true;
+}
+
+//Returns BITBASE_WIN if one of children, the positions after every move of p, is
+//lost for the opponent, BITBASE_LOSS if all of them are won by the opponent and
+//UNDECIDED otherwise. Positions of the table being built are read from results.
+int bitbase::childrenResult(const bbPosition& p, vector<bbPosition>& children, bool hasPawns,
+                            const vector<unsigned char>& results)
+{
+    bool allWon = true;
+    for(unsigned int i = 0; i < children.size(); i++)
+    {
+        bbPosition& child = children[i];
+        bool sameTable = child.numPieces == p.numPieces;
+        for(int j = 0; sameTable && j < p.numPieces; j++)
+            sameTable = child.type[j] == p.type[j];
+
+        int result;
+        if(sameTable)
+        {
+            normalizeSquares(child, hasPawns);
+            result = results[positionIndex(child, hasPawns)];
+        }
+        else
+        {
+            //captures and promotions lead to tables that are already built
+            result = probe(child);
+        }
+        if(result == BITBASE_LOSS)
+            return BITBASE_WIN;
+        if(result != BITBASE_WIN)
+            allWon = false;
+    }
+    return allWon ? BITBASE_LOSS : UNDECIDED;
+}
+
+//Builds a table by retrograde analysis once the tables its captures and promotions
+//lead to exist. A first pass finds the invalid, checkmated and stalemated positions
+//and the positions its captures and promotions already decide. Every decided
+//position then goes back over the moves that lead to it: a position with a move to
+//a lost position is won, and a position with a move to a won position is lost once
+//all of its moves lead to won positions. The positions left are draws.
+bool bitbase::build(const string& signature)
+{
+    if(tables.count(signature) != 0 || mapTable(signature))
+        return true;
+
+    bbPosition base = signaturePosition(signature);
+    for(int i = 2; i < base.numPieces; i++)
+    {
+        if(base.numPieces > 3 && !build(relatedSignature(base, i, -1)))
+            return false;
+        for(int promotion = KNIGHT; base.type[i] == PAWN && promotion <= QUEEN; promotion++)
+        {
+            if(!build(relatedSignature(base, i, promotion)))
+                return false;
+        }
+    }
+
+    bool hasPawns = signature.find('P') != string::npos;
+    unsigned long long numPositions = tableSize(base.numPieces, hasPawns);
+    vector<unsigned char> results(numPositions, UNDECIDED);
+    vector<bbPosition> children;
+    vector<bbPosition> parents;
+    vector<unsigned int> decided;
+    vector<unsigned int> nextDecided;
+    bbPosition p = base;
+    bbPosition parent = base;
+    cout << "Building " << signature << " (" << numPositions << " positions)" << endl;
+
+    for(unsigned long long index = 0; index < numPositions; index++)
+    {
+        decodeIndex(p, index, hasPawns);
+        if(!isValid(p))
+        {
+            results[index] = BITBASE_INVALID;
+            continue;
+        }
+        generateMoves(p, children);
+        if(children.empty())
+            results[index] = attacked(p, kingSquare(p, p.sideToMove), p.sideToMove ^ 1) ? BITBASE_LOSS : BITBASE_DRAW;
+        else
+            results[index] = childrenResult(p, children, hasPawns, results);
+        if(results[index] == BITBASE_WIN || results[index] == BITBASE_LOSS)
+            decided.push_back(index);
+    }
+
+    //each round decides the positions one move further from the end
+    int rounds = 0;
+    while(!decided.empty())
+    {
+        rounds++;
+        nextDecided.clear();
+        for(unsigned int i = 0; i < decided.size(); i++)
+        {
+            int result = results[decided[i]];
+            decodeIndex(p, decided[i], hasPawns);
+            generateUnmoves(p, parents);
+            for(unsigned int j = 0; j < parents.size(); j++)
+            {
+                unsigned long long parentIndexes[2];
+                int numIndexes = tableIndexes(parents[j], hasPawns, parentIndexes);
+                for(int k = 0; k < numIndexes; k++)
+                {
+                    unsigned long long index = parentIndexes[k];
+                    if(results[index] != UNDECIDED)
+                        continue;
+                    if(result == BITBASE_LOSS)
+                    {
+                        results[index] = BITBASE_WIN;
+                    }
+                    else
+                    {
+                        decodeIndex(parent, index, hasPawns);
+                        generateMoves(parent, children);
+                        results[index] = childrenResult(parent, children, hasPawns, results);
+                        if(results[index] == UNDECIDED)
+                            continue;
+                    }
+                    nextDecided.push_back(index);
+                }
+            }
+        }
+        decided.swap(nextDecided);
+    }
+
+    //pack the results four to a byte
+    long long counts[4] = {0, 0, 0, 0};
+    vector<unsigned char> packed((numPositions + 3) / 4, 0);
+    for(unsigned long long index = 0; index < numPositions; index++)
+    {
+        int result = (results[index] == UNDECIDED) ? BITBASE_DRAW : results[index];
+        counts[result]++;
+        packed[index >> 2] |= result << ((index & 3) * 2);
+    }
+    cout << "  " << rounds << " rounds, " << counts[BITBASE_WIN] << " won, " << counts[BITBASE_DRAW]
+         << " drawn, " << counts[BITBASE_LOSS] << " lost" << endl;
+
+    string path = directory + "/" + signature + ".bb";
+    ofstream out(path.c_str(), ios::binary);
+    unsigned int numPieces = base.numPieces;
+    out.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+    out.write((const char*)&numPieces, sizeof(numPieces));
+    out.write((const char*)&numPositions, sizeof(numPositions));
+    out.write((const char*)packed.data(), packed.size());
+    out.close();
+    if(!out)
+    {
+        cerr << "Could not write " << path << endl;
+        return false;
+    }
+    return mapTable(signature);
+}
@@ -0,0 +1,89 @@
+/*
+ * bitbase.h
+ * This file contains the header information for the bitbase class, which builds
+ * win/draw/loss tables of endings with three or four pieces by retrograde analysis
+ * and looks positions up in them during a search.
+ */
+
+#ifndef BITBASE_H_
+#define BITBASE_H_
+
+#include "game.h"
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//The result stored for every position of a table, seen by the player to move
+const int BITBASE_DRAW = 0;
+const int BITBASE_WIN = 1;
+const int BITBASE_LOSS = 2;
+const int BITBASE_INVALID = 3;
+//Returned by a probe when no table covers the position
+const int BITBASE_UNKNOWN = -1;
+
+//A position of an ending with at most four pieces. Piece types use the indexes of
+//the Zobrist tables from pawn 0 to king 5, colors are 0 for white and 1 for black,
+//and squares run from a1 as 0 to h8 as 63.
+struct bbPosition
+{
+    int numPieces = 0;
+    int type[4];
+    int color[4];
+    int square[4];
+    int sideToMove = 0;
+};
+
+//The table of one material configuration such as KRKP, named with white's pieces
+//first. White is always the stronger side and its king is kept on one half of the
+//board, or one eighth without pawns, by mirroring. The results are packed four to
+//a byte after a short header.
+struct bitbaseTable
+{
+    bool hasPawns = false;
+    unsigned long long numPositions = 0;
+    const unsigned char* data = NULL;
+    void* mapping = NULL;
+    size_t mappingSize = 0;
+};
+
+//The bitbase class maps the table files of a directory into memory and answers
+//probes for positions of their endings. Probes only read the mapped files so every
+//search thread can share one bitbase. The tables ignore castling, en passant and
+//the fifty move rule.
+class bitbase
+{
+    public:
+        static const int MAX_PIECES = 4;
+
+        bitbase() {}
+        ~bitbase();
+        bitbase(const bitbase&) = delete;
+        bitbase& operator=(const bitbase&) = delete;
+
+        //Maps every table file found in dir and returns the number of tables mapped
+        int load(const string& dir);
+        bool isLoaded();
+        //Returns the result of s for its player to move, or BITBASE_UNKNOWN when no
+        //table covers it
+        int probe(state& s);
+
+        //Builds the tables of signatures in dir along with every table they depend
+        //on, skipping tables already built. An empty list builds every ending of
+        //three and four pieces. Returns false if a signature or file is bad.
+        bool generate(const string& dir, vector<string> signatures);
+
+    private:
+        map<string, bitbaseTable> tables;
+        string directory;
+
+        bool mapTable(const string& signature);
+        bool build(const string& signature);
+        int probe(bbPosition& p);
+        int childrenResult(const bbPosition& p, vector<bbPosition>& children, bool hasPawns,
+                           const vector<unsigned char>& results);
+        int tableResult(const bitbaseTable& table, unsigned long long index);
+};
+
+#endif /* BITBASE_H_ */
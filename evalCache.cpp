@@ -0,0 +1,44 @@
+/*
+ * evalCache.cpp
+ * This file contains the function implementations for the evalCache class.
+ */
+
+#include "evalCache.h"
+
+using namespace std;
+
+//The number of entries is rounded down to a power of two so the index can be
+//taken directly from the low bits of the key
+evalCache::evalCache(int sizeMB)
+{
+    unsigned long long bytes = (unsigned long long)(sizeMB > 0 ? sizeMB : 1) * 1024 * 1024;
+    numEntries = 1;
+    while(numEntries * 2 * sizeof(evalEntry) <= bytes)
+        numEntries *= 2;
+    entries.reset(new evalEntry[numEntries]);
+    for(unsigned long long i = 0; i < numEntries; i++)
+    {
+        entries[i].key.store(0, memory_order_relaxed);
+        entries[i].data.store(0, memory_order_relaxed);
+    }
+}
+
+//The data word holds the utility in its low 32 bits and a set bit 32 so a
+//stored evaluation is never mistaken for an empty slot
+bool evalCache::probe(unsigned long long key, int& utility)
+{
+    evalEntry& e = entries[key & (numEntries - 1)];
+    unsigned long long data = e.data.load(memory_order_relaxed);
+    if(data == 0 || (e.key.load(memory_order_relaxed) ^ data) != key)
+        return false;
+    utility = (int)(unsigned int)(data & 0xFFFFFFFF);
+    return true;
+}
+
+void evalCache::store(unsigned long long key, int utility)
+{
+    evalEntry& e = entries[key & (numEntries - 1)];
+    unsigned long long data = (unsigned long long)(unsigned int)utility | (1ULL << 32);
+    e.key.store(key ^ data, memory_order_relaxed);
+    e.data.store(data, memory_order_relaxed);
+}
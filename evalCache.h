@@ -0,0 +1,40 @@
+/*
+ * evalCache.h
+ * This file contains the header information for the evalCache class.
+ */
+
+#ifndef EVALCACHE_H_
+#define EVALCACHE_H_
+
+#include <atomic>
+#include <memory>
+
+using namespace std;
+
+//A single slot of the cache. As in the transposition table the key is stored
+//XOR'd with the data so a slot torn by two threads fails verification.
+struct evalEntry
+{
+    atomic<unsigned long long> key;
+    atomic<unsigned long long> data;
+};
+
+//The evalCache class remembers the static evaluations of recently evaluated states
+//keyed by their Zobrist hash. It is shared by every search thread without locks.
+//A slot is simply overwritten by the next state that maps to it, so the cache
+//may forget a state but never returns another state's evaluation.
+class evalCache
+{
+    public:
+        evalCache(int sizeMB);
+
+        //Returns true and sets utility if key has a stored evaluation
+        bool probe(unsigned long long key, int& utility);
+        void store(unsigned long long key, int utility);
+
+    private:
+        unique_ptr<evalEntry[]> entries;
+        unsigned long long numEntries = 0;
+};
+
+#endif /* EVALCACHE_H_ */
@@ -0,0 +1,41 @@
+/*
+ * evalWeights.h
+ * This file contains the evalWeights struct, which holds the weights of the
+ * evaluation terms the tune command adjusts.
+ */
+
+#ifndef EVALWEIGHTS_H_
+#define EVALWEIGHTS_H_
+
+#include "tunedWeights.h"
+
+//The weights of the evaluation terms the tune command adjusts. They start with the
+//values it last wrote to tunedWeights.h. Utilities are in units where a pawn is 1000.
+struct evalWeights
+{
+    //Piece values
+    int pawnValue = TUNED_PAWN_VALUE;
+    int knightValue = TUNED_KNIGHT_VALUE;
+    int bishopValue = TUNED_BISHOP_VALUE;
+    int rookValue = TUNED_ROOK_VALUE;
+    int queenValue = TUNED_QUEEN_VALUE;
+    //A king safety difference above safetyThresh earns the queen of the safer side
+    //queenBonusWeakKing
+    int safetyThresh = TUNED_SAFETY_THRESH;
+    int queenBonusWeakKing = TUNED_QUEEN_BONUS_WEAK_KING;
+    //Rook placement, see state::rookUtilitySub()
+    int rookOn7 = TUNED_ROOK_ON_7;
+    int rookConnectedOn7 = TUNED_ROOK_CONNECTED_ON_7;
+    int rookOpenFile = TUNED_ROOK_OPEN_FILE;
+    int rookConnectedOpenFile = TUNED_ROOK_CONNECTED_OPEN_FILE;
+    int rookHalfOpenFile = TUNED_ROOK_HALF_OPEN_FILE;
+    //Development and castling, see state::openingUtility()
+    int nudge = TUNED_NUDGE;
+    int unmovedPenalty = TUNED_UNMOVED_PENALTY;
+    int queenIsEarly = TUNED_QUEEN_IS_EARLY;
+    int cantCastle = TUNED_CANT_CASTLE;
+    int notYetCastle = TUNED_NOT_YET_CASTLE;
+    int castled = TUNED_CASTLED;
+};
+
+#endif /* EVALWEIGHTS_H_ */
@@ -5,16 +5,169 @@
 
 #include "game.h"
 #include "ai.h"
+#include "evalCache.h"
 #include <iostream>
 #include <time.h>
 #include <fstream>
 #include <queue>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
 
 using namespace std;
 
-bool state::whiteHasCastled = false;
-bool state::blackHasCastled = false;
-
+unsigned long long state::zobristPieces[2][6][64];
+unsigned long long state::zobristCastling[16];
+unsigned long long state::zobristEnPassant[9];
+unsigned long long state::zobristBlackToMove;
+evalWeights state::weights;
+int state::weightsGeneration = 0;
+const int state::ACTIVITY_LIMIT;
+int state::lazyMidgameMargin = state::midgameMargin();
+int state::lazyEndgameMargin = state::endgameMargin();
+
+//The piece-square tables from white's side, a row per rank from rank 1 up to
+//rank 8. The endgame tables only differ for pawns, which gain as they advance,
+//and the king, which moves to the center.
+const int state::PSQ_MIDGAME[6][64] =
+{
+    //Pawn
+    {
+           0,    0,    0,    0,    0,    0,    0,    0,
+           5,   10,   10,  -20,  -20,   10,   10,    5,
+           5,   -5,  -10,    0,    0,  -10,   -5,    5,
+           0,    0,    0,   20,   20,    0,    0,    0,
+           5,    5,   10,   25,   25,   10,    5,    5,
+          10,   10,   20,   30,   30,   20,   10,   10,
+          50,   50,   50,   50,   50,   50,   50,   50,
+           0,    0,    0,    0,    0,    0,    0,    0
+    },
+    //Knight
+    {
+         -50,  -40,  -30,  -30,  -30,  -30,  -40,  -50,
+         -40,  -20,    0,    5,    5,    0,  -20,  -40,
+         -30,    5,   10,   15,   15,   10,    5,  -30,
+         -30,    0,   15,   20,   20,   15,    0,  -30,
+         -30,    5,   15,   20,   20,   15,    5,  -30,
+         -30,    0,   10,   15,   15,   10,    0,  -30,
+         -40,  -20,    0,    0,    0,    0,  -20,  -40,
+         -50,  -40,  -30,  -30,  -30,  -30,  -40,  -50
+    },
+    //Bishop
+    {
+         -20,  -10,  -10,  -10,  -10,  -10,  -10,  -20,
+         -10,    5,    0,    0,    0,    0,    5,  -10,
+         -10,   10,   10,   10,   10,   10,   10,  -10,
+         -10,    0,   10,   10,   10,   10,    0,  -10,
+         -10,    5,    5,   10,   10,    5,    5,  -10,
+         -10,    0,    5,   10,   10,    5,    0,  -10,
+         -10,    0,    0,    0,    0,    0,    0,  -10,
+         -20,  -10,  -10,  -10,  -10,  -10,  -10,  -20
+    },
+    //Rook
+    {
+           0,    0,    0,    5,    5,    0,    0,    0,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+           5,   10,   10,   10,   10,   10,   10,    5,
+           0,    0,    0,    0,    0,    0,    0,    0
+    },
+    //Queen
+    {
+         -20,  -10,  -10,   -5,   -5,  -10,  -10,  -20,
+         -10,    0,    5,    0,    0,    0,    0,  -10,
+         -10,    5,    5,    5,    5,    5,    0,  -10,
+           0,    0,    5,    5,    5,    5,    0,   -5,
+          -5,    0,    5,    5,    5,    5,    0,   -5,
+         -10,    0,    5,    5,    5,    5,    0,  -10,
+         -10,    0,    0,    0,    0,    0,    0,  -10,
+         -20,  -10,  -10,   -5,   -5,  -10,  -10,  -20
+    },
+    //King
+    {
+          20,   30,   10,    0,    0,   10,   30,   20,
+          20,   20,    0,    0,    0,    0,   20,   20,
+         -10,  -20,  -20,  -20,  -20,  -20,  -20,  -10,
+         -20,  -30,  -30,  -40,  -40,  -30,  -30,  -20,
+         -30,  -40,  -40,  -50,  -50,  -40,  -40,  -30,
+         -30,  -40,  -40,  -50,  -50,  -40,  -40,  -30,
+         -30,  -40,  -40,  -50,  -50,  -40,  -40,  -30,
+         -30,  -40,  -40,  -50,  -50,  -40,  -40,  -30
+    }
+};
+
+const int state::PSQ_ENDGAME[6][64] =
+{
+    //Pawn
+    {
+           0,    0,    0,    0,    0,    0,    0,    0,
+           0,    0,    0,    0,    0,    0,    0,    0,
+           5,    5,    5,    5,    5,    5,    5,    5,
+          10,   10,   10,   10,   10,   10,   10,   10,
+          20,   20,   20,   20,   20,   20,   20,   20,
+          35,   35,   35,   35,   35,   35,   35,   35,
+          60,   60,   60,   60,   60,   60,   60,   60,
+           0,    0,    0,    0,    0,    0,    0,    0
+    },
+    //Knight
+    {
+         -50,  -40,  -30,  -30,  -30,  -30,  -40,  -50,
+         -40,  -20,    0,    5,    5,    0,  -20,  -40,
+         -30,    5,   10,   15,   15,   10,    5,  -30,
+         -30,    0,   15,   20,   20,   15,    0,  -30,
+         -30,    5,   15,   20,   20,   15,    5,  -30,
+         -30,    0,   10,   15,   15,   10,    0,  -30,
+         -40,  -20,    0,    0,    0,    0,  -20,  -40,
+         -50,  -40,  -30,  -30,  -30,  -30,  -40,  -50
+    },
+    //Bishop
+    {
+         -20,  -10,  -10,  -10,  -10,  -10,  -10,  -20,
+         -10,    5,    0,    0,    0,    0,    5,  -10,
+         -10,   10,   10,   10,   10,   10,   10,  -10,
+         -10,    0,   10,   10,   10,   10,    0,  -10,
+         -10,    5,    5,   10,   10,    5,    5,  -10,
+         -10,    0,    5,   10,   10,    5,    0,  -10,
+         -10,    0,    0,    0,    0,    0,    0,  -10,
+         -20,  -10,  -10,  -10,  -10,  -10,  -10,  -20
+    },
+    //Rook
+    {
+           0,    0,    0,    5,    5,    0,    0,    0,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+           5,   10,   10,   10,   10,   10,   10,    5,
+           0,    0,    0,    0,    0,    0,    0,    0
+    },
+    //Queen
+    {
+         -20,  -10,  -10,   -5,   -5,  -10,  -10,  -20,
+         -10,    0,    5,    0,    0,    0,    0,  -10,
+         -10,    5,    5,    5,    5,    5,    0,  -10,
+           0,    0,    5,    5,    5,    5,    0,   -5,
+          -5,    0,    5,    5,    5,    5,    0,   -5,
+         -10,    0,    5,    5,    5,    5,    0,  -10,
+         -10,    0,    0,    0,    0,    0,    0,  -10,
+         -20,  -10,  -10,   -5,   -5,  -10,  -10,  -20
+    },
+    //King
+    {
+         -50,  -30,  -30,  -30,  -30,  -30,  -30,  -50,
+         -30,  -30,    0,    0,    0,    0,  -30,  -30,
+         -30,  -10,   20,   30,   30,   20,  -10,  -30,
+         -30,  -10,   30,   40,   40,   30,  -10,  -30,
+         -30,  -10,   30,   40,   40,   30,  -10,  -30,
+         -30,  -10,   20,   30,   30,   20,  -10,  -30,
+         -30,  -20,  -10,    0,    0,  -10,  -20,  -30,
+         -50,  -40,  -30,  -20,  -20,  -30,  -40,  -50
+    }
+};
 
 
 //Returns a vector of all possible moves possible from state
@@ -24,57 +177,82 @@ bool state::blackHasCastled = false;
 vector<action> state::actions(bool existenceCheck)
 {
     vector<action> results;
-    vector<action> newMoves;
+    actions(results, existenceCheck);
+    return results;
+}
 
+//Fills results with the possible moves from state, reusing the vector's storage
+//so the game tree search does not allocate a new list at every node
+void state::actions(vector<action>& results, bool existenceCheck)
+{
+    results.clear();
     for(unsigned int i = 0; i < currentPlayer->pieces.size(); i++)
     {
         if(currentPlayer->pieces[i]->type == "King")
         {
-            newMoves = generateKingMoves(currentPlayer->pieces[i]);
+            generateKingMoves(currentPlayer->pieces[i], results);
         }
         else if(currentPlayer->pieces[i]->type == "Queen")
         {
-            newMoves = generateQueenMoves(currentPlayer->pieces[i]);
+            generateQueenMoves(currentPlayer->pieces[i], results);
         }
         else if(currentPlayer->pieces[i]->type == "Knight")
         {
-            newMoves = generateKnightMoves(currentPlayer->pieces[i]);
+            generateKnightMoves(currentPlayer->pieces[i], results);
         }
         else if(currentPlayer->pieces[i]->type == "Rook")
         {
-            newMoves = generateRookMoves(currentPlayer->pieces[i]);
+            generateRookMoves(currentPlayer->pieces[i], results);
         }
         else if(currentPlayer->pieces[i]->type == "Bishop")
         {
-            newMoves = generateBishopMoves(currentPlayer->pieces[i]);
+            generateBishopMoves(currentPlayer->pieces[i], results);
         }
         else if(currentPlayer->pieces[i]->type == "Pawn")
         {
-            newMoves = generatePawnMoves(currentPlayer->pieces[i]);
+            if(currentPlayer->rankDirection == 1)
+                generatePawnMoves<0>(currentPlayer->pieces[i], results);
+            else
+                generatePawnMoves<1>(currentPlayer->pieces[i], results);
         }
         //if a move exists return the set of moves found
-        if(existenceCheck)
-        {
-            if(results.size() > 0)
-                return results;
-        }
-        //add new moves to total results
-        for(unsigned int j = 0; j < newMoves.size(); j++)
-        {
-            results.push_back(newMoves[j]);
-        }
-
+        if(existenceCheck && results.size() > 0)
+            return;
     }
-    return results;
 }
 
 //returns a state that occurs from the calling state taking action a
 //the resulting state will only calculate and store its utility if calcUtil is true
 //if calcTerminal is true, the resulting state will do an abbreviated utility
 //check to see if the state is terminal or not. This is stored in the state's isTerminalState.
-state state::result(action& a, bool calcUtil, int strategy, bool calcTerminal, bool isOpening)
+//the calling state's utility is carried in its utilityValue rather than recalculated
+state state::result(action& a, bool calcUtil, int strategy, bool calcTerminal)
 {
     state tmp;
+    resultInto(tmp, a, calcUtil, strategy, calcTerminal, utilityValue);
+    return tmp;
+}
+
+//Picks the resultInto() compiled for strategy
+void state::resultInto(state& tmp, action& a, bool calcUtil, int strategy, bool calcTerminal, int utility,
+                       int alpha, int beta, int lazyChange)
+{
+    if(strategy == 1)
+        resultInto<1>(tmp, a, calcUtil, calcTerminal, utility, alpha, beta, lazyChange);
+    else if(strategy == 2)
+        resultInto<2>(tmp, a, calcUtil, calcTerminal, utility, alpha, beta, lazyChange);
+    else
+        resultInto<0>(tmp, a, calcUtil, calcTerminal, utility, alpha, beta, lazyChange);
+}
+
+//Stores the state that occurs from the calling state taking action a in tmp. Reusing
+//a tmp that already holds a board avoids allocating new pieces. utility is the calling
+//state's utility, used to find the change in utility when calcUtil is true. alpha,
+//beta and lazyChange are passed on to calculateUtility().
+template <int Strategy>
+void state::resultInto(state& tmp, action& a, bool calcUtil, bool calcTerminal, int utility,
+                       int alpha, int beta, int lazyChange)
+{
     tmp = *this;
     unsigned int i = 0;
 
@@ -88,6 +266,13 @@ state state::result(action& a, bool calcUtil, int strategy, bool calcTerminal, b
 
     //save pointer to target piece to move
     myPiece* movedPiece = tmp.currentPlayer->pieces[i];
+    int color = (tmp.currentPlayer->rankDirection == 1) ? 0 : 1;
+    int movedType = pieceIndex(movedPiece->type);
+
+    //remove the moved piece, castling rights, and en passant file from the key
+    tmp.hashKey ^= zobristEnPassant[tmp.enPassantFile()] ^ zobristCastling[tmp.castlingRights];
+    tmp.hashKey ^= zobristPieces[color][movedType][squareIndex(a.oldRank, a.oldFile)];
+    tmp.addPieceScores(color, movedType, squareIndex(a.oldRank, a.oldFile), -1);
 
     movedPiece->hasMoved = true;
 
@@ -131,6 +316,8 @@ state state::result(action& a, bool calcUtil, int strategy, bool calcTerminal, b
         }
 
         //update position of rook for castling
+        tmp.hashKey ^= zobristPieces[color][3][squareIndex(a.newRank, targetFile)];
+        tmp.addPieceScores(color, 3, squareIndex(a.newRank, targetFile), -1);
         if(a.newFile > a.oldFile)
         {
             tmp.currentPlayer->pieces[i]->file = intToFile(fileToInt(a.newFile) - 1);
@@ -139,6 +326,8 @@ state state::result(action& a, bool calcUtil, int strategy, bool calcTerminal, b
         {
             tmp.currentPlayer->pieces[i]->file = intToFile(fileToInt(a.newFile) + 1);
         }
+        tmp.hashKey ^= zobristPieces[color][3][squareIndex(a.newRank, tmp.currentPlayer->pieces[i]->file)];
+        tmp.addPieceScores(color, 3, squareIndex(a.newRank, tmp.currentPlayer->pieces[i]->file), 1);
         if(tmp.currentPlayer->rankDirection == 1)
             tmp.whiteHasCastled = true;
         else
@@ -148,6 +337,45 @@ state state::result(action& a, bool calcUtil, int strategy, bool calcTerminal, b
     //update moved piece location on board
     movedPiece->file = a.newFile;
     movedPiece->rank = a.newRank;
+    movedType = pieceIndex(movedPiece->type);
+    tmp.hashKey ^= zobristPieces[color][movedType][squareIndex(a.newRank, a.newFile)];
+    tmp.addPieceScores(color, movedType, squareIndex(a.newRank, a.newFile), 1);
+    tmp.updateMaterialDifference();
+
+    //a side whose king moved rebuilds its accumulator here once rather than in
+    //every state searched below this one
+    for(int color = 0; color < 2; color++)
+    {
+        if(accumulatorValid[color] && !tmp.accumulatorValid[color] && !tmp.skipsAccumulators)
+            tmp.refreshAccumulator(color);
+    }
+
+    //moving to or from a king or rook starting square removes castling rights
+    int touched[2] = {squareIndex(a.oldRank, a.oldFile), squareIndex(a.newRank, a.newFile)};
+    for(int j = 0; j < 2; j++)
+    {
+        switch(touched[j])
+        {
+            case 4:
+                tmp.castlingRights &= ~3;
+                break;
+            case 7:
+                tmp.castlingRights &= ~1;
+                break;
+            case 0:
+                tmp.castlingRights &= ~2;
+                break;
+            case 60:
+                tmp.castlingRights &= ~12;
+                break;
+            case 63:
+                tmp.castlingRights &= ~4;
+                break;
+            case 56:
+                tmp.castlingRights &= ~8;
+                break;
+        }
+    }
 
     //store this action as the previous action by erasing the earliest action
     if(tmp.previousActions.size() >= 8)
@@ -156,13 +384,14 @@ state state::result(action& a, bool calcUtil, int strategy, bool calcTerminal, b
 
     //the resulting state is the opponent's move
     tmp.currentPlayer = tmp.currentPlayer->opponent;
+    tmp.hashKey ^= zobristEnPassant[tmp.enPassantFile()] ^ zobristCastling[tmp.castlingRights] ^ zobristBlackToMove;
 
 
     //calculates utility if prompted
     if(calcUtil)
     {
-        tmp.utilityValue = tmp.calculateUtility(isOpening, strategy);
-        tmp.quiescentChange = tmp.utilityValue - this->calculateUtility(isOpening, strategy);
+        tmp.utilityValue = tmp.calculateUtility<Strategy>(alpha, beta, utility, lazyChange);
+        tmp.quiescentChange = tmp.utilityValue - utility;
     }
     //Optionally checks whether a state is the end of the game
     else if(calcTerminal)
@@ -175,8 +404,6 @@ state state::result(action& a, bool calcUtil, int strategy, bool calcTerminal, b
         if(isDraw())
             isTerminalState = true;
     }
-
-    return tmp;
 }
 
 state::state()
@@ -208,20 +435,33 @@ state::~state()
 
 void state::operator=(const state& s)
 {
-    //clear old memory
-    for(unsigned int i = 0; i < players[0]->pieces.size(); i++)
-        delete players[0]->pieces[i];
-    for(unsigned int i = 0; i < players[1]->pieces.size(); i++)
-        delete players[1]->pieces[i];
-    players[0]->pieces.clear();
-    players[1]->pieces.clear();
     utilityValue = s.utilityValue;
     materialDifference = s.materialDifference;
     quiescentChange = s.quiescentChange;
+    for(int color = 0; color < 2; color++)
+    {
+        material[color] = s.material[color];
+        psqMidgame[color] = s.psqMidgame[color];
+        psqEndgame[color] = s.psqEndgame[color];
+    }
+    phaseMaterial = s.phaseMaterial;
     isTerminalState = s.isTerminalState;
 
     whiteHasCastled = s.whiteHasCastled;
     blackHasCastled = s.blackHasCastled;
+    castlingRights = s.castlingRights;
+    hashKey = s.hashKey;
+    pawnKey = s.pawnKey;
+
+    //the network's accumulators are only copied for the sides that hold them, and
+    //never into a board that skips them
+    for(int color = 0; color < 2; color++)
+    {
+        accumulatorValid[color] = s.accumulatorValid[color] && !skipsAccumulators;
+        accumulatorKing[color] = s.accumulatorKing[color];
+        if(accumulatorValid[color])
+            memcpy(accumulator[color], s.accumulator[color], sizeof(accumulator[color]));
+    }
 
     //copy previous actions
     previousActions.clear();
@@ -241,45 +481,124 @@ void state::operator=(const state& s)
     else
         maxPlayer = currentPlayer->opponent;
 
-    myPiece* tmp;
+    //copy the pieces of both players
+    copyPieces(s.currentPlayer, currentPlayer);
+    copyPieces(s.currentPlayer->opponent, currentPlayer->opponent);
+}
 
-    //copy current player pieces
-    for(unsigned int i = 0; i < s.currentPlayer->pieces.size(); i++)
+//Copies the pieces of from into to. The pieces to already owns are reused and only
+//the difference in the number of pieces is allocated or freed.
+void state::copyPieces(const myPlayer* from, myPlayer* to)
+{
+    while(to->pieces.size() > from->pieces.size())
+    {
+        delete to->pieces.back();
+        to->pieces.pop_back();
+    }
+    while(to->pieces.size() < from->pieces.size())
     {
-        tmp = new myPiece;
-        tmp->file = s.currentPlayer->pieces[i]->file;
-        tmp->rank = s.currentPlayer->pieces[i]->rank;
-        tmp->hasMoved = s.currentPlayer->pieces[i]->hasMoved;
-        tmp->owner = currentPlayer;
-        tmp->type = s.currentPlayer->pieces[i]->type;
-        currentPlayer->pieces.push_back(tmp);
+        to->pieces.push_back(new myPiece);
     }
 
-    //copy opponent pieces
-    for(unsigned int i = 0; i < s.currentPlayer->opponent->pieces.size(); i++)
+    for(unsigned int i = 0; i < from->pieces.size(); i++)
     {
-        tmp = new myPiece;
-        tmp->file = s.currentPlayer->opponent->pieces[i]->file;
-        tmp->rank = s.currentPlayer->opponent->pieces[i]->rank;
-        tmp->hasMoved = s.currentPlayer->opponent->pieces[i]->hasMoved;
-        tmp->owner = currentPlayer->opponent;
-        tmp->type = s.currentPlayer->opponent->pieces[i]->type;
-        currentPlayer->opponent->pieces.push_back(tmp);
+        myPiece* tmp = to->pieces[i];
+        tmp->file = from->pieces[i]->file;
+        tmp->rank = from->pieces[i]->rank;
+        tmp->hasMoved = from->pieces[i]->hasMoved;
+        tmp->owner = to;
+        tmp->type = from->pieces[i]->type;
     }
 }
 
-//Returns the utility of the state. isOpening is a flag to determine
-//if the state is early on in the game which requires an additional
-//set of calculations to encourage early piece development.
-//The strategy integer determines what process is used by the function
-//to determine the utility. Currently the options are 0 for a complex
-//strategy and 1 for a simplified version.
-int state::calculateUtility(bool isOpening, int strategy)
+//Returns the evaluation cache shared by every strategy and search
+static evalCache& sharedEvalCache()
 {
-    int totalUtility = 0;
+    static evalCache cache(state::EVAL_CACHE_MB);
+    return cache;
+}
+
+//Picks the calculateUtility() compiled for strategy
+int state::calculateUtility(int strategy, int alpha, int beta, int parentUtility, int lazyChange)
+{
+    if(strategy == 1)
+        return calculateUtility<1>(alpha, beta, parentUtility, lazyChange);
+    else if(strategy == 2)
+        return calculateUtility<2>(alpha, beta, parentUtility, lazyChange);
+    return calculateUtility<0>(alpha, beta, parentUtility, lazyChange);
+}
+
+//Returns the utility of the state, looking it up in the evaluation cache shared
+//by every search before evaluating the state. The cache holds utilities for the
+//player to move under a key salted with the strategy and the max player, since
+//both change the utility. Repetitions depend on the moves that led to the state,
+//which its key does not describe, so they are checked first. Like the
+//transposition table the cache treats states with equal keys as equal even if
+//pieces that returned to their starting squares count as moved in one of them.
+//A search passes its alpha beta window, and a utility far outside the window is
+//returned without evaluating every term. Such utilities are not cached. The search
+//also compares the utility with parentUtility to decide quiescent extensions, so a
+//lazy utility is only returned when it differs from parentUtility by more than
+//lazyChange whatever the remaining terms add (see ai::lazyChange()).
+template <int Strategy>
+int state::calculateUtility(int alpha, int beta, int parentUtility, int lazyChange)
+{
+    static evalCache& cache = sharedEvalCache();
+    const unsigned long long EVAL_SALT = 0x9E3779B97F4A7C15ULL;
+
+    if(isDraw())
+        return DRAWVALUE;
+
+    //the states searched from this one update its accumulators instead of building
+    //their own, even when this state's utility is found in the cache
+    if(Strategy == 2 && nnue::network().isLoaded())
+    {
+        for(int color = 0; color < 2; color++)
+        {
+            if(!accumulatorValid[color])
+                refreshAccumulator(color);
+        }
+    }
 
-    int playerMaterial = 0;
-    int opponentMaterial = 0;
+    int maxColor = (maxPlayer->rankDirection == 1) ? 0 : 1;
+    //the strategies and max players take six salts, so every weights generation
+    //starts a new block of them
+    unsigned long long key = hashKey ^ (EVAL_SALT * (weightsGeneration * 6 + Strategy * 2 + maxColor + 1));
+    int sign = (currentPlayer == maxPlayer) ? 1 : -1;
+    int utility;
+    if(cache.probe(key, utility))
+        return sign * utility;
+
+    bool isExact;
+    if(maxColor == 0)
+        utility = evaluate<Strategy, 0>(alpha, beta, parentUtility, lazyChange, isExact);
+    else
+        utility = evaluate<Strategy, 1>(alpha, beta, parentUtility, lazyChange, isExact);
+    if(isExact)
+        cache.store(key, sign * utility);
+    return utility;
+}
+
+//The game tree search of the ai class uses these versions directly
+template void state::resultInto<0>(state&, action&, bool, bool, int, int, int, int);
+template void state::resultInto<1>(state&, action&, bool, bool, int, int, int, int);
+template void state::resultInto<2>(state&, action&, bool, bool, int, int, int, int);
+template int state::calculateUtility<0>(int, int, int, int);
+template int state::calculateUtility<1>(int, int, int, int);
+template int state::calculateUtility<2>(int, int, int, int);
+
+//Evaluates the utility of the state. Every term has a midgame and an endgame
+//score which are blended by the game phase, so the utility changes smoothly
+//as pieces are traded instead of jumping between stages of the game.
+//The Strategy determines what process is used by the function to determine
+//the utility. Currently the options are 0 for a complex strategy, 1 for a
+//simplified version and 2 for the neural network, which falls back to
+//strategy 0 when no network is loaded. Color is the max player's color.
+template <int Strategy, int Color>
+int state::evaluate(int alpha, int beta, int parentUtility, int lazyChange, bool& isExact)
+{
+    int midgameUtility = 0;
+    int endgameUtility = 0;
 
     myPiece* myKing = NULL;
     myPiece* oppKing = NULL;
@@ -288,6 +607,8 @@ int state::calculateUtility(bool isOpening, int strategy)
     bool myHasQueen = false;
     bool oppHasQueen = false;
 
+    isExact = true;
+
     //generate possible actions to see if any exist
     vector<action> possibleMoves;
     possibleMoves = actions(true);
@@ -301,11 +622,6 @@ int state::calculateUtility(bool isOpening, int strategy)
         else
             return CHECKMATEVALUE;
     }
-    //evaluates whether a state is a draw
-    else if(isDraw())
-    {
-        return DRAWVALUE;
-    }
     //if there are no moves available but the opponent is not in check, it is a stalemate
     //the value of this state is treated the same as a draw state because there is no winner
     else if(possibleMoves.size() == 0)
@@ -313,180 +629,149 @@ int state::calculateUtility(bool isOpening, int strategy)
         return DRAWVALUE;
     }
 
-    if(strategy == 1)
+    if(Strategy == 1)
     {
     	return materialDifference;
     }
+    else if(Strategy == 2 && nnue::network().isLoaded())
+    {
+    	return neuralUtility();
+    }
     else
     {
-    	//piece value calculation for maxPlayer
+    	//the material, piece-square and pawn terms come from the accumulators and
+    	//the pawn table, so they cost almost nothing
+    	int phase = gamePhase();
+
+		midgameUtility += materialDifference;
+		endgameUtility += materialDifference;
+
+		//Reward pieces standing on good squares for the stage of the game
+		midgameUtility += psqMidgame[Color] - psqMidgame[1 - Color];
+		endgameUtility += psqEndgame[Color] - psqEndgame[1 - Color];
+
+		//Reward a sound pawn structure
+		pawnEntry& pawns = pawnStructure();
+		const int pawnSign = (Color == 0) ? 1 : -1;
+		midgameUtility += pawnSign * pawns.midgame;
+		endgameUtility += pawnSign * pawns.endgame;
+
+		//When the remaining terms cannot bring the utility back inside the search's
+		//window, nor its change from parentUtility back within lazyChange, the utility
+		//is only needed to fail low or high
+		int lazyUtility = (midgameUtility * phase + endgameUtility * (MAX_PHASE - phase)) / MAX_PHASE;
+		int margin = (lazyMidgameMargin * phase + lazyEndgameMargin * (MAX_PHASE - phase)) / MAX_PHASE + 1;
+		if((lazyUtility + margin < alpha || lazyUtility - margin > beta) &&
+		   abs(lazyUtility - parentUtility) - margin > lazyChange)
+		{
+			isExact = false;
+			return lazyUtility;
+		}
+
+    	//the pieces are only searched for the kings, rooks and queens the other terms look at
     	for(unsigned int i = 0; i < maxPlayer->pieces.size(); i++)
     	{
-    		if(maxPlayer->pieces[i]->type == "King")
-    		{
-    			myKing = maxPlayer->pieces[i];
-    		}
-    		else if(maxPlayer->pieces[i]->type == "Queen")
-    		{
-    			playerMaterial += QUEENVALUE;
+    		myPiece* piece = maxPlayer->pieces[i];
+    		if(piece->type == "King")
+    			myKing = piece;
+    		else if(piece->type == "Queen")
     			myHasQueen = true;
-    		}
-    		else if(maxPlayer->pieces[i]->type == "Rook")
-    		{
-    			playerMaterial += ROOKVALUE;
-    			myRooks.push_back(maxPlayer->pieces[i]);
-    		}
-    		else if(maxPlayer->pieces[i]->type == "Bishop")
-    		{
-    			playerMaterial += BISHOPVALUE;
-    		}
-    		else if(maxPlayer->pieces[i]->type == "Knight")
-    		{
-    			playerMaterial += KNIGHTVALUE;
-    		}
-    		else if(maxPlayer->pieces[i]->type == "Pawn")
-    		{
-    			playerMaterial += PAWNVALUE;
-    		}
+    		else if(piece->type == "Rook")
+    			myRooks.push_back(piece);
     	}
 
-    	//piece value calculation for minPlayer
 		for(unsigned int i = 0; i < maxPlayer->opponent->pieces.size(); i++)
 		{
-			if(maxPlayer->opponent->pieces[i]->type == "King")
-			{
-				oppKing = maxPlayer->opponent->pieces[i];
-			}
-			else if(maxPlayer->opponent->pieces[i]->type == "Queen")
-			{
-				opponentMaterial += QUEENVALUE;
+			myPiece* piece = maxPlayer->opponent->pieces[i];
+			if(piece->type == "King")
+				oppKing = piece;
+			else if(piece->type == "Queen")
 				oppHasQueen = true;
-			}
-			else if(maxPlayer->opponent->pieces[i]->type == "Rook")
-			{
-				opponentMaterial += ROOKVALUE;
-				oppRooks.push_back(maxPlayer->opponent->pieces[i]);
-			}
-			else if(maxPlayer->opponent->pieces[i]->type == "Bishop")
-			{
-				opponentMaterial += BISHOPVALUE;
-			}
-			else if(maxPlayer->opponent->pieces[i]->type == "Knight")
+			else if(piece->type == "Rook")
+				oppRooks.push_back(piece);
+		}
+
+		//Reward states with valuable rook placement
+		int rookDifference = rookUtility<Color>(pawns, myRooks, oppRooks);
+		midgameUtility += rookDifference;
+		endgameUtility += rookDifference;
+
+		//Reward mobile pieces and pieces threatening the opponent's
+		attackMap attacks;
+		attacks.build(*this);
+		int activityMidgame = 0;
+		int activityEndgame = 0;
+		mobilityUtility<Color>(attacks, activityMidgame, activityEndgame);
+		int threatDifference = threatUtility<Color>(attacks);
+		activityMidgame += threatDifference;
+		activityEndgame += threatDifference;
+		midgameUtility += max(-ACTIVITY_LIMIT, min(ACTIVITY_LIMIT, activityMidgame));
+		endgameUtility += max(-ACTIVITY_LIMIT, min(ACTIVITY_LIMIT, activityEndgame));
+
+		//King safety, the queen's attack on a weak king and the development of the
+		//pieces only matter while there are pieces left to attack with
+		if(phase > 0)
+		{
+			//Reward states where the king is safe and the queen is still in play
+			int safetyDifference = kingSafetyUtility<Color>(pawns, attacks, myKing, oppKing);
+
+			if(safetyDifference > weights.safetyThresh)
 			{
-				opponentMaterial += KNIGHTVALUE;
+				if(myHasQueen)
+					midgameUtility += weights.queenBonusWeakKing;
 			}
-			else if(maxPlayer->opponent->pieces[i]->type == "Pawn")
+			else if(safetyDifference < -weights.safetyThresh)
 			{
-				opponentMaterial += PAWNVALUE;
+				if(oppHasQueen)
+					midgameUtility -= weights.queenBonusWeakKing;
 			}
-		}
 
-		totalUtility += (playerMaterial - opponentMaterial);
-
-		//Reward states where the king is safe and the queen is still in play
-		int safetyDifference = kingSafetyUtility(myKing, oppKing);
-
-		if(safetyDifference > SAFETY_THRESH)
-		{
-			if(myHasQueen)
-				totalUtility += QUEEN_BONUS_WEAK_KING;
-		}
-		else if(safetyDifference < -SAFETY_THRESH)
-		{
-			if(oppHasQueen)
-				totalUtility -= QUEEN_BONUS_WEAK_KING;
+			midgameUtility += safetyDifference;
+			midgameUtility += openingUtility<Color>();
 		}
 
-		totalUtility += safetyDifference;
-
-		//Reward states with valuable rook placement
-		totalUtility += rookUtility(myRooks, oppRooks);
+		//Chasing the opponent's king to a corner only matters once pieces are traded
+		if(phase < MAX_PHASE)
+			endgameUtility += endingUtility();
 
-		//Update utility during the opening and closing of the game
-		if(isOpening)
-		{
-			totalUtility += openingUtility();
-		}
-		else if(opponentMaterial < END_GAME_CUTOFF)
-		{
-			totalUtility += endingUtility();
-		}
-		return totalUtility;
+		return (midgameUtility * phase + endgameUtility * (MAX_PHASE - phase)) / MAX_PHASE;
 	}
 }
 
+//Returns the network's utility from the accumulators of both sides, which
+//calculateUtility() has made valid. The network scores the state for the player
+//to move, so the utility is turned around when that is not the max player.
+int state::neuralUtility()
+{
+	int us = (currentPlayer->rankDirection == 1) ? 0 : 1;
+	int utility = nnue::network().evaluate(accumulator[us], accumulator[1 - us]);
+	//keep the network's scores clear of the checkmate values
+	utility = max(-CHECKMATEVALUE / 2, min(CHECKMATEVALUE / 2, utility));
+	return (currentPlayer == maxPlayer) ? utility : -utility;
+}
+
+//Returns the game phase, clamped to MAX_PHASE since promotions can add pieces
+int state::gamePhase()
+{
+	return min(phaseMaterial, MAX_PHASE);
+}
+
 //This function updates the materialDifference variable so
 //that it reflects the perspective of the current maxPlayer
 void state::updateMaterialDifference()
 {
-	int playerMaterial = 0;
-	int opponentMaterial = 0;
-
-	//piece value calculation for maxPlayer
-	for(unsigned int i = 0; i < maxPlayer->pieces.size(); i++)
-	{
-		if(maxPlayer->pieces[i]->type == "Queen")
-		{
-			playerMaterial += QUEENVALUE;
-		}
-		else if(maxPlayer->pieces[i]->type == "Rook")
-		{
-			playerMaterial += ROOKVALUE;
-		}
-		else if(maxPlayer->pieces[i]->type == "Bishop")
-		{
-			playerMaterial += BISHOPVALUE;
-		}
-		else if(maxPlayer->pieces[i]->type == "Knight")
-		{
-			playerMaterial += KNIGHTVALUE;
-		}
-		else if(maxPlayer->pieces[i]->type == "Pawn")
-		{
-			playerMaterial += PAWNVALUE;
-		}
-	}
-
-	//piece value calculation for minPlayer
-	for(unsigned int i = 0; i < maxPlayer->opponent->pieces.size(); i++)
-	{
-		if(maxPlayer->opponent->pieces[i]->type == "Queen")
-		{
-			opponentMaterial += QUEENVALUE;
-		}
-		else if(maxPlayer->opponent->pieces[i]->type == "Rook")
-		{
-			opponentMaterial += ROOKVALUE;
-		}
-		else if(maxPlayer->opponent->pieces[i]->type == "Bishop")
-		{
-			opponentMaterial += BISHOPVALUE;
-		}
-		else if(maxPlayer->opponent->pieces[i]->type == "Knight")
-		{
-			opponentMaterial += KNIGHTVALUE;
-		}
-		else if(maxPlayer->opponent->pieces[i]->type == "Pawn")
-		{
-			opponentMaterial += PAWNVALUE;
-		}
-	}
-
-	materialDifference = (playerMaterial - opponentMaterial);
+	int color = (maxPlayer->rankDirection == 1) ? 0 : 1;
+	materialDifference = material[color] - material[1 - color];
 }
 
 //Opening utility penalizes major pieces for not moving
 //It also penalizes states that cannot castle or have yet to do so
 //while rewarding a successful castle attempt
 //The queen will be punished if it enters play too early
+//Color is the max player's color
+template <int Color>
 int state::openingUtility()
 {
-    const int NUDGE = -10;
-    const int UNMOVED_PENALTY = -100;
-    const int QUEEN_IS_EARLY = -50;
-    const int CANT_CASTLE = -300;
-    const int NOT_YET_CASTLE = -150;
-    const int CASTLED = 2000;
 
     int myUtility = 0;
     int oppUtility = 0;
@@ -528,48 +813,29 @@ int state::openingUtility()
         if(!minorPieces[i]->hasMoved)
         {
             if(fileToInt(minorPieces[i]->file) > 4)
-                myUtility += NUDGE;
-            myUtility += UNMOVED_PENALTY;
+                myUtility += weights.nudge;
+            myUtility += weights.unmovedPenalty;
             allPiecesDeveloped = false;
         }
     }
 
     if(queen != NULL)
         if(queen->hasMoved && !allPiecesDeveloped)
-            myUtility += QUEEN_IS_EARLY;
+            myUtility += weights.queenIsEarly;
 
-    if(maxPlayer->rankDirection == 1)
+    if(!((Color == 0) ? whiteHasCastled : blackHasCastled))
     {
-    	if(!whiteHasCastled)
+    	myUtility += weights.notYetCastle;
+    	for(unsigned int i = 0; i < rooks.size(); i++)
     	{
-    		myUtility += NOT_YET_CASTLE;
-    		for(unsigned int i = 0; i < rooks.size(); i++)
-    		{
-    			if(rooks[i]->hasMoved)
-    		        myUtility += CANT_CASTLE;
-    		}
-    		if(king->hasMoved)
-    		    myUtility += CANT_CASTLE;
+    		if(rooks[i]->hasMoved)
+    	        myUtility += weights.cantCastle;
     	}
-    	else
-    		myUtility += CASTLED;
+    	if(king->hasMoved)
+    	    myUtility += weights.cantCastle;
     }
     else
-    {
-    	if(!blackHasCastled)
-    	{
-    	    myUtility += NOT_YET_CASTLE;
-    	    for(unsigned int i = 0; i < rooks.size(); i++)
-    	    {
-    	    	if(rooks[i]->hasMoved)
-    	    	    myUtility += CANT_CASTLE;
-    	    }
-    	    if(king->hasMoved)
-    	    	myUtility += CANT_CASTLE;
-    	}
-    	else
-    		myUtility += CASTLED;
-    }
+    	myUtility += weights.castled;
 
     //opponent player utility
     allPiecesDeveloped = true;
@@ -605,47 +871,28 @@ int state::openingUtility()
     {
         if(!minorPieces[i]->hasMoved)
         {
-            oppUtility += UNMOVED_PENALTY;
+            oppUtility += weights.unmovedPenalty;
             allPiecesDeveloped = false;
         }
     }
 
     if(queen != NULL)
         if(queen->hasMoved && !allPiecesDeveloped)
-            oppUtility += QUEEN_IS_EARLY;
+            oppUtility += weights.queenIsEarly;
 
-    if(maxPlayer->opponent->rankDirection == 1)
+    if(!((Color == 0) ? blackHasCastled : whiteHasCastled))
     {
-        if(!whiteHasCastled)
-        {
-        	oppUtility += NOT_YET_CASTLE;
-        	for(unsigned int i = 0; i < rooks.size(); i++)
-        	{
-        		if(rooks[i]->hasMoved)
-        		    oppUtility += CANT_CASTLE;
-        	}
-        	if(king->hasMoved)
-        		oppUtility += CANT_CASTLE;
-        }
-        else
-        	oppUtility += CASTLED;
+    	oppUtility += weights.notYetCastle;
+    	for(unsigned int i = 0; i < rooks.size(); i++)
+    	{
+    		if(rooks[i]->hasMoved)
+    		    oppUtility += weights.cantCastle;
+    	}
+    	if(king->hasMoved)
+    		oppUtility += weights.cantCastle;
     }
     else
-    {
-        if(!blackHasCastled)
-        {
-        	oppUtility += NOT_YET_CASTLE;
-        	for(unsigned int i = 0; i < rooks.size(); i++)
-        	{
-        	    if(rooks[i]->hasMoved)
-        	    	oppUtility += CANT_CASTLE;
-        	}
-        	if(king->hasMoved)
-        	    oppUtility += CANT_CASTLE;
-        }
-        else
-        	oppUtility += CASTLED;
-    }
+    	oppUtility += weights.castled;
 
     return myUtility - oppUtility;
 }
@@ -694,23 +941,11 @@ int state::endingUtility()
 }
 
 //The rook utility functions determines the parameters for each player's utility function
-int state::rookUtility(vector<myPiece*>& myRooks, vector<myPiece*>& oppRooks)
+//Color is the max player's color
+template <int Color>
+int state::rookUtility(pawnEntry& pawns, vector<myPiece*>& myRooks, vector<myPiece*>& oppRooks)
 {
-    int myUtility = 0;
-    int oppUtility = 0;
-
-    if(maxPlayer->rankDirection == 1)
-    {
-        myUtility = rookUtilitySub(maxPlayer, myRooks, 7);
-        oppUtility = rookUtilitySub(maxPlayer->opponent, oppRooks, 2);
-    }
-    else
-    {
-        myUtility = rookUtilitySub(maxPlayer, myRooks, 2);
-        oppUtility = rookUtilitySub(maxPlayer->opponent, oppRooks, 7);
-    }
-
-    return myUtility - oppUtility;
+    return rookUtilitySub<Color>(pawns, myRooks) - rookUtilitySub<1 - Color>(pawns, oppRooks);
 }
 
 //Returns true if the rooks are connected
@@ -760,16 +995,15 @@ bool state::connected(vector<myPiece*>& rooks)
 //The rook utility rewards rooks that are connected and if they have access to
 //an open file or the opponent's back line because these conditions allow
 //safe attacks against undeployed opponent pieces
-int state::rookUtilitySub(myPlayer* player, vector<myPiece*>& rooks, int enemyRank)
+//Color is the color of the rooks
+template <int Color>
+int state::rookUtilitySub(pawnEntry& pawns, vector<myPiece*>& rooks)
 {
-    const int ROOK_ON_7 = 200;
-    const int ROOK_CONNECTED_ON_7 = 100;
-    const int ROOK_OPEN_FILE = 100;
-    const int ROOK_CONNECTED_OPEN_FILE = 50;
-    const int ROOK_HALF_OPEN_FILE = 50;
     int utility = 0;
     int openFileType;
     bool areConnected = false;
+    //the rank of the opponent's pawns, behind which its pieces stand
+    const int enemyRank = (Color == 0) ? 7 : 2;
 
     if(rooks.size() == 2)
     {
@@ -778,22 +1012,22 @@ int state::rookUtilitySub(myPlayer* player, vector<myPiece*>& rooks, int enemyRa
 
     for(unsigned int i = 0; i < rooks.size(); i++)
     {
-        openFileType = isOpenFile(rooks[i]->file, player);
+        openFileType = isOpenFile(pawns, fileToInt(rooks[i]->file), Color);
         if(openFileType == -2)
         {
-            utility += ROOK_OPEN_FILE;
+            utility += weights.rookOpenFile;
             if(areConnected)
-                utility += ROOK_CONNECTED_OPEN_FILE;
+                utility += weights.rookConnectedOpenFile;
         }
         else if(openFileType == 2 || openFileType == -1)
-            utility += ROOK_HALF_OPEN_FILE;
+            utility += weights.rookHalfOpenFile;
 
         if(rooks[i]->rank == enemyRank)
         {
-            utility += ROOK_ON_7;
+            utility += weights.rookOn7;
             if(areConnected)
             {
-                utility += ROOK_CONNECTED_ON_7;
+                utility += weights.rookConnectedOn7;
             }
         }
     }
@@ -801,195 +1035,273 @@ int state::rookUtilitySub(myPlayer* player, vector<myPiece*>& rooks, int enemyRa
     return utility;
 }
 
-//Determines the parameters of the king safety functions
-int state::kingSafetyUtility(myPiece* myKing, myPiece* oppKing)
+//Determines the parameters of the king safety functions, the shelter of each king
+//and the danger of the pieces attacking it
+//Color is the max player's color
+template <int Color>
+int state::kingSafetyUtility(pawnEntry& pawns, attackMap& attacks, myPiece* myKing, myPiece* oppKing)
 {
     const int SAFETY_MODIFIER = -25;
 
-    int mySafety;
-    int oppSafety;
+    int shelter = SAFETY_MODIFIER * (kingSafety<Color>(pawns, myKing) - kingSafety<1 - Color>(pawns, oppKing));
+    return shelter - kingDanger<Color>(attacks) + kingDanger<1 - Color>(attacks);
+}
+
+//Returns the danger the opponent's pieces pose to the king of Color. Attack units
+//are counted for the pieces attacking the king zone, the zone squares they hit,
+//the zone squares no piece but the king defends, and the safe squares the
+//opponent can check the king from. The danger grows with the square of the units,
+//so a lone attacker counts for little and a combined attack for much more.
+template <int Color>
+int state::kingDanger(attackMap& attacks)
+{
+    const int ZONE_HIT_UNITS = 2;
+    const int WEAK_SQUARE_UNITS = 3;
+    const int KNIGHT_CHECK_UNITS = 10;
+    const int BISHOP_CHECK_UNITS = 6;
+    const int ROOK_CHECK_UNITS = 8;
+    const int QUEEN_CHECK_UNITS = 8;
+    //An attack without the queen is much less likely to succeed
+    const int NO_QUEEN_DIVISOR = 2;
+    const int DANGER_DIVISOR = 4;
+    const int KING_DANGER_MAX = 2000;
+    const int enemy = 1 - Color;
+
+    int king = attacks.kingSquare[Color];
+    bool enemyHasQueen = attacks.pieces[enemy][4] != 0;
+    if(king < 0 || attacks.kingAttackers[Color] == 0 || (attacks.kingAttackers[Color] < 2 && !enemyHasQueen))
+        return 0;
+
+    int units = attacks.kingAttackers[Color] * attacks.kingAttackWeight[Color];
+    units += ZONE_HIT_UNITS * attacks.kingZoneHits[Color];
+
+    unsigned long long defended = attacks.attacks[Color][0] | attacks.attacks[Color][1] | attacks.attacks[Color][2] |
+                                  attacks.attacks[Color][3] | attacks.attacks[Color][4];
+    units += WEAK_SQUARE_UNITS * attackMap::count(attacks.kingZone[Color] & attacks.attacked[enemy] & ~defended);
+
+    //checks from squares the king's side does not defend and the opponent does not occupy
+    unsigned long long safe = ~attacks.attacked[Color] & ~attacks.occupied[enemy];
+    unsigned long long diagonals = attackMap::bishopAttacks(king, attacks.all);
+    unsigned long long lines = attackMap::rookAttacks(king, attacks.all);
+    if(attackMap::knightAttacks(king) & attacks.attacks[enemy][1] & safe)
+        units += KNIGHT_CHECK_UNITS;
+    if(diagonals & attacks.attacks[enemy][2] & safe)
+        units += BISHOP_CHECK_UNITS;
+    if(lines & attacks.attacks[enemy][3] & safe)
+        units += ROOK_CHECK_UNITS;
+    if((diagonals | lines) & attacks.attacks[enemy][4] & safe)
+        units += QUEEN_CHECK_UNITS;
+
+    if(!enemyHasQueen)
+        units /= NO_QUEEN_DIVISOR;
+    return min(KING_DANGER_MAX, units * units / DANGER_DIVISOR);
+}
+
+//Adds the mobility of the max player's knights, bishops, rooks and queens less the
+//opponent's to midgame and endgame. A piece earns its bonus for every safe square
+//it reaches beyond the typical number and loses it for every square short of it.
+//Color is the max player's color.
+template <int Color>
+void state::mobilityUtility(attackMap& attacks, int& midgame, int& endgame)
+{
+    //by piece index: the typical number of safe squares, and the bonus per square
+    const int TYPICAL_SQUARES[5] = {0, 4, 6, 7, 13};
+    const int MOBILITY_MIDGAME[5] = {0, 40, 50, 20, 10};
+    const int MOBILITY_ENDGAME[5] = {0, 40, 50, 40, 20};
 
-    if(maxPlayer->rankDirection == 1)
+    for(int type = 1; type < 5; type++)
     {
-        mySafety = kingSafetyWhite(maxPlayer, myKing);
-        oppSafety = kingSafetyBlack(maxPlayer->opponent, oppKing);
+        int pieceCount = attackMap::count(attacks.pieces[Color][type]);
+        int oppCount = attackMap::count(attacks.pieces[1 - Color][type]);
+        int squares = (attacks.mobility[Color][type] - TYPICAL_SQUARES[type] * pieceCount) -
+                      (attacks.mobility[1 - Color][type] - TYPICAL_SQUARES[type] * oppCount);
+        midgame += squares * MOBILITY_MIDGAME[type];
+        endgame += squares * MOBILITY_ENDGAME[type];
     }
-    else
-    {
-        mySafety = kingSafetyBlack(maxPlayer, myKing);
-        oppSafety = kingSafetyWhite(maxPlayer->opponent, oppKing);
+}
+
+//Returns the threats of the max player's pieces less the opponent's. A piece is
+//threatened when a piece worth less attacks it, and hanging when the opponent
+//attacks it and nothing defends it. Color is the max player's color.
+template <int Color>
+int state::threatUtility(attackMap& attacks)
+{
+    //by piece index of the threatened piece
+    const int THREATENED[5] = {0, 300, 300, 400, 500};
+    const int HANGING = 200;
+
+    int utility = 0;
+    for(int side = 0; side < 2; side++)
+    {
+        //the side's pieces are the targets, the opponent's attacks the threats
+        int target = (side == 0) ? 1 - Color : Color;
+        int attacker = 1 - target;
+        int sign = (side == 0) ? 1 : -1;
+
+        //squares attacked by pieces worth less than each type, knights and bishops
+        //being worth the same
+        unsigned long long byPawns = attacks.attacks[attacker][0];
+        unsigned long long byMinors = byPawns | attacks.attacks[attacker][1] | attacks.attacks[attacker][2];
+        unsigned long long byRooks = byMinors | attacks.attacks[attacker][3];
+        const unsigned long long lesser[5] = {0, byPawns, byPawns, byMinors, byRooks};
+        for(int type = 1; type < 5; type++)
+            utility += sign * THREATENED[type] * attackMap::count(attacks.pieces[target][type] & lesser[type]);
+        unsigned long long hanging = attacks.occupied[target] & ~attacks.pieces[target][5] &
+                                     attacks.attacked[attacker] & ~attacks.attacked[target];
+        utility += sign * HANGING * attackMap::count(hanging);
     }
+    return utility;
+}
 
-    return SAFETY_MODIFIER * (mySafety - oppSafety);
+//Returns the shelter zone of a king standing on file
+static int shelterZone(int file)
+{
+    if(file < 4)
+        return SHELTER_QUEEN_SIDE;
+    if(file > 5)
+        return SHELTER_KING_SIDE;
+    return (file == 4) ? SHELTER_D_FILE : SHELTER_E_FILE;
 }
 
-//King safety rewards
-int state::kingSafetyBlack(myPlayer* black, myPiece* king)
+//King safety rewards for the king of Color. The pawn shelter of the king's zone
+//comes from the pawn structure, only the king's own position is looked at here.
+template <int Color>
+int state::kingSafety(pawnEntry& pawns, myPiece* king)
 {
-    const int IN_CENTER = 5;
-    const int OPEN_FILE = 6;
     const int NOT_CORNER = 2;
     const int IN_CORNER = 3;
-    const int PAWN_ATTACK_BARRIER = 10;
 
-    const int ROOK_PAWN_1 = 3;
-    const int ROOK_PAWN_2 = 6;
-    const int ROOK_PAWN_MISSING = 8;
-    const int ROOK_PAWN_FAR = 8;
-    const int ROOK_PAWN_OPEN = 10;
+    int file = fileToInt(king->file);
+    //ranks counted from the king's own side of the board
+    int rank = (Color == 0) ? king->rank : 9 - king->rank;
+    int safetyIssues = pawns.shelter[Color][shelterZone(file)];
 
-    const int KNIGHT_PAWN_1 = 2;
-    const int KNIGHT_PAWN_2 = 5;
-    const int KNIGHT_PAWN_MISSING = 8;
-    const int KNIGHT_PAWN_FAR = 8;
-    const int KNIGHT_PAWN_OPEN = 10;
+    //penalize king for not being near the corner and for being exactly in corner
+    if(file < 4 || file > 5)
+    {
+        if((file > 2) && (file < 7)) safetyIssues += NOT_CORNER;
 
-    const int BISHOP_PAWN_1 = 1;
-    const int BISHOP_PAWN_2 = 2;
-    const int BISHOP_PAWN_MISSING = 2;
-    const int BISHOP_PAWN_FAR = 2;
+        if(rank > 1) safetyIssues += NOT_CORNER;
+        if(rank > 2) safetyIssues += NOT_CORNER;
+        if(rank > 3) safetyIssues += NOT_CORNER;
+        if(rank == 1 && (file == 1 || file == 8))
+            safetyIssues += IN_CORNER;
+    }
 
-    string rookFile;
-    string knightFile;
-    string bishopFile;
-    int safetyIssues = 0;
-    int fileInfo;
-    int progression;
-    int file;
+    return safetyIssues;
+}
 
-    //sets the target rook, knight, and bishop files to the side the king is on
-    if(fileToInt(king->file) < 4)
-    {
-        rookFile = "a";
-        knightFile = "b";
-        bishopFile = "c";
-    }
-    else if(fileToInt(king->file) > 5)
-    {
-        rookFile = "h";
-        knightFile = "g";
-        bishopFile = "f";
-    }
-    //If the king is in the center it is penalized
-    else
+//Returns the pawn structure of the state from the searching thread's pawn table,
+//evaluating it first if the table does not hold it
+pawnEntry& state::pawnStructure()
+{
+    static thread_local pawnTable pawnHash;
+    bool found;
+    pawnEntry& pawns = pawnHash.probe(pawnKey, found);
+    if(!found)
+        evaluatePawns(pawns);
+    return pawns;
+}
+
+//Fills in the pawn structure entry from the pawns of both players. Doubled and
+//isolated pawns are penalized and passed pawns rewarded more the further they
+//have advanced, especially in the endgame.
+void state::evaluatePawns(pawnEntry& pawns)
+{
+    const int DOUBLED_MIDGAME = -100;
+    const int DOUBLED_ENDGAME = -200;
+    const int ISOLATED_MIDGAME = -100;
+    const int ISOLATED_ENDGAME = -150;
+    const int PASSED_MIDGAME[9] = {0, 0, 0, 20, 40, 80, 150, 250, 0};
+    const int PASSED_ENDGAME[9] = {0, 0, 0, 50, 100, 200, 350, 500, 0};
+
+    for(int color = 0; color < 2; color++)
     {
-        safetyIssues += IN_CENTER;
-        //Additional penalties are added if the king is near open files with easy access
-        //for opponent's pieces
-        if(king->file == "d")
+        pawns.files[color] = 0;
+        pawns.passed[color] = 0;
+        for(int file = 0; file < 8; file++)
         {
-            if(isOpenFile("c", black) < 0)
-                safetyIssues += OPEN_FILE;
-            if(isOpenFile("d", black) < 0)
-                safetyIssues += OPEN_FILE;
-            if(isOpenFile("e", black) < 0)
-                safetyIssues += OPEN_FILE;
-        }
-        else
-        {
-            if(isOpenFile("d", black) < 0)
-                safetyIssues += OPEN_FILE;
-            if(isOpenFile("e", black) < 0)
-                safetyIssues += OPEN_FILE;
-            if(isOpenFile("f", black) < 0)
-                safetyIssues += OPEN_FILE;
+            pawns.backRank[color][file] = 0;
+            pawns.frontRank[color][file] = 0;
         }
     }
+    pawns.midgame = 0;
+    pawns.endgame = 0;
 
-    if(!safetyIssues)
+    for(unsigned int p = 0; p < players.size(); p++)
     {
-        //Rook Pawn
-    	//If the pawn on the rook's file is absent or far away
-    	//the state is penalized
-        fileInfo = isOpenFile(rookFile, black);
-        if(fileInfo < 0)
-            safetyIssues += ROOK_PAWN_MISSING;
-        if(fileInfo == -2)
-            safetyIssues += ROOK_PAWN_OPEN;
-        else
-        {
-            progression = pawnProgression(rookFile, black);
-            if(progression == 1)
-                safetyIssues += ROOK_PAWN_1;
-            else if(progression == 2)
-                safetyIssues += ROOK_PAWN_2;
-            else if(progression > 2)
-                safetyIssues += ROOK_PAWN_FAR;
-        }
-
-        //Knight Pawn
-        //If the pawn on the knight's file is absent or far away
-        //the state is penalized
-        fileInfo = isOpenFile(knightFile, black);
-        if(fileInfo < 0)
-            safetyIssues += KNIGHT_PAWN_MISSING;
-        if(fileInfo == -2)
-            safetyIssues += KNIGHT_PAWN_OPEN;
-        else
+        int color = (players[p]->rankDirection == 1) ? 0 : 1;
+        for(unsigned int i = 0; i < players[p]->pieces.size(); i++)
         {
-            progression = pawnProgression(knightFile, black);
-            if(progression == 1)
-                safetyIssues += KNIGHT_PAWN_1;
-            else if(progression == 2)
-                safetyIssues += KNIGHT_PAWN_2;
-            else if(progression > 2)
-                safetyIssues += KNIGHT_PAWN_FAR;
+            myPiece* piece = players[p]->pieces[i];
+            if(piece->type != "Pawn")
+                continue;
+            int file = fileToInt(piece->file) - 1;
+            int rank = (color == 0) ? piece->rank : 9 - piece->rank;
+            if(pawns.files[color] & (1 << file))
+            {
+                pawns.midgame += (color == 0) ? DOUBLED_MIDGAME : -DOUBLED_MIDGAME;
+                pawns.endgame += (color == 0) ? DOUBLED_ENDGAME : -DOUBLED_ENDGAME;
+            }
+            pawns.files[color] |= 1 << file;
+            if(pawns.backRank[color][file] == 0 || rank < pawns.backRank[color][file])
+                pawns.backRank[color][file] = rank;
+            pawns.frontRank[color][file] = max(pawns.frontRank[color][file], rank);
         }
+    }
 
-        //Bishop Pawn
-        //If the pawn on the bishop's file is absent or far away
-        //the state is penalized
-        if(safetyIssues > 1)
+    for(int color = 0; color < 2; color++)
+    {
+        int sign = (color == 0) ? 1 : -1;
+        for(int file = 0; file < 8; file++)
         {
-            fileInfo = isOpenFile(bishopFile, black);
-            if(abs(fileInfo) == 2)
-                safetyIssues += BISHOP_PAWN_MISSING;
-            else
+            if(!(pawns.files[color] & (1 << file)))
+                continue;
+            int neighbours = ((file > 0) ? pawns.files[color] & (1 << (file - 1)) : 0) |
+                             ((file < 7) ? pawns.files[color] & (1 << (file + 1)) : 0);
+            if(neighbours == 0)
             {
-                progression = pawnProgression(bishopFile, black);
-                if(progression == 1)
-                    safetyIssues += BISHOP_PAWN_1;
-                else if(progression == 2)
-                    safetyIssues += BISHOP_PAWN_2;
-                else if(progression > 2)
-                    safetyIssues += BISHOP_PAWN_FAR;
+                pawns.midgame += sign * ISOLATED_MIDGAME;
+                pawns.endgame += sign * ISOLATED_ENDGAME;
             }
-        }
 
-        //check for pawn at g6/b6 that can break barrier
-        for(unsigned int i = 0; i < black->opponent->pieces.size(); i++)
-        {
-            if(black->opponent->pieces[i]->rank == 6 && black->opponent->pieces[i]->file == knightFile)
+            //the front pawn is passed if no enemy pawn on its file or a neighbouring
+            //file stands in front of it. Enemy ranks are seen from the enemy's side.
+            int rank = pawns.frontRank[color][file];
+            bool isPassed = true;
+            for(int enemyFile = max(0, file - 1); enemyFile <= min(7, file + 1); enemyFile++)
             {
-                safetyIssues += PAWN_ATTACK_BARRIER;
-                break;
+                int enemyRank = pawns.backRank[1 - color][enemyFile];
+                if(enemyRank != 0 && 9 - enemyRank > rank)
+                    isPassed = false;
+            }
+            if(isPassed)
+            {
+                int square = ((color == 0) ? rank - 1 : 8 - rank) * 8 + file;
+                pawns.passed[color] |= 1ULL << square;
+                pawns.midgame += sign * PASSED_MIDGAME[rank];
+                pawns.endgame += sign * PASSED_ENDGAME[rank];
             }
         }
-
-        //penalize king for not being near the corner and for being exactly in corner
-        file = fileToInt(king->file);
-        if((file > 2) && (file < 7)) safetyIssues += NOT_CORNER;
-        if((file > 3) && (file < 6)) safetyIssues += NOT_CORNER;
-
-        if(king->rank < 8) safetyIssues += NOT_CORNER;
-        if(king->rank < 7) safetyIssues += NOT_CORNER;
-        if(king->rank < 6) safetyIssues += NOT_CORNER;
-        if(king->rank == 8 && (file == 1 || file == 8))
-            safetyIssues += IN_CORNER;
     }
 
-    return safetyIssues;
+    for(int color = 0; color < 2; color++)
+        for(int zone = 0; zone < 4; zone++)
+            pawns.shelter[color][zone] = pawnShelter(pawns, color, zone);
 }
 
-//Offers the same calculations as kingSafetyBlack but from the
-//white pieces perspective
-int state::kingSafetyWhite(myPlayer* white, myPiece* king)
+//Returns the shelter issues of color's pawns for a king in zone. A king in the
+//center is penalized along with every nearby file the opponent has no pawns on.
+//A king on a wing is penalized for every missing or advanced pawn in front of it
+//and for an enemy pawn close to breaking the shelter.
+int state::pawnShelter(pawnEntry& pawns, int color, int zone)
 {
     const int IN_CENTER = 5;
     const int OPEN_FILE = 6;
-    const int NOT_CORNER = 2;
-    const int IN_CORNER = 3;
     const int PAWN_ATTACK_BARRIER = 10;
+    //Issues of the most advanced enemy pawn on a file in front of the king by the
+    //enemy's rank, for a pawn storm about to open the file
+    const int PAWN_STORM[9] = {0, 0, 0, 0, 1, 3, 6, 3, 0};
 
     const int ROOK_PAWN_1 = 3;
     const int ROOK_PAWN_2 = 6;
@@ -1008,132 +1320,105 @@ int state::kingSafetyWhite(myPlayer* white, myPiece* king)
     const int BISHOP_PAWN_MISSING = 2;
     const int BISHOP_PAWN_FAR = 2;
 
-    string rookFile;
-    string knightFile;
-    string bishopFile;
     int safetyIssues = 0;
     int fileInfo;
     int progression;
-    int file;
 
-    if(fileToInt(king->file) < 4)
-    {
-        rookFile = "a";
-        knightFile = "b";
-        bishopFile = "c";
-    }
-    else if(fileToInt(king->file) > 5)
-    {
-        rookFile = "h";
-        knightFile = "g";
-        bishopFile = "f";
-    }
-    else
-    {
-        safetyIssues += IN_CENTER;
-        if(king->file == "d")
-        {
-            if(isOpenFile("c", white) < 0)
-                safetyIssues += OPEN_FILE;
-            if(isOpenFile("d", white) < 0)
-                safetyIssues += OPEN_FILE;
-            if(isOpenFile("e", white) < 0)
-                safetyIssues += OPEN_FILE;
-        }
-        else
+    if(zone == SHELTER_D_FILE || zone == SHELTER_E_FILE)
+    {
+        //Additional penalties are added if the king is near open files with easy access
+        //for opponent's pieces
+        safetyIssues += IN_CENTER;
+        int firstFile = (zone == SHELTER_D_FILE) ? 3 : 4;
+        for(int file = firstFile; file < firstFile + 3; file++)
         {
-            if(isOpenFile("d", white) < 0)
-                safetyIssues += OPEN_FILE;
-            if(isOpenFile("e", white) < 0)
-                safetyIssues += OPEN_FILE;
-            if(isOpenFile("f", white) < 0)
+            if(isOpenFile(pawns, file, color) < 0)
                 safetyIssues += OPEN_FILE;
         }
+        return safetyIssues;
     }
 
-    if(!safetyIssues)
+    //sets the target rook, knight, and bishop files to the side the king is on
+    int rookFile = (zone == SHELTER_QUEEN_SIDE) ? 1 : 8;
+    int knightFile = (zone == SHELTER_QUEEN_SIDE) ? 2 : 7;
+    int bishopFile = (zone == SHELTER_QUEEN_SIDE) ? 3 : 6;
+
+    //Rook Pawn
+    //If the pawn on the rook's file is absent or far away
+    //the state is penalized
+    fileInfo = isOpenFile(pawns, rookFile, color);
+    if(fileInfo < 0)
+        safetyIssues += ROOK_PAWN_MISSING;
+    if(fileInfo == -2)
+        safetyIssues += ROOK_PAWN_OPEN;
+    else
     {
-        //Rook Pawn
-        fileInfo = isOpenFile(rookFile, white);
-        if(fileInfo < 0)
-            safetyIssues += ROOK_PAWN_MISSING;
-        if(fileInfo == -2)
-            safetyIssues += ROOK_PAWN_OPEN;
-        else
-        {
-            progression = pawnProgression(rookFile, white);
-            if(progression == 1)
-                safetyIssues += ROOK_PAWN_1;
-            else if(progression == 2)
-                safetyIssues += ROOK_PAWN_2;
-            else if(progression > 2)
-                safetyIssues += ROOK_PAWN_FAR;
-        }
+        progression = pawnProgression(pawns, rookFile, color);
+        if(progression == 1)
+            safetyIssues += ROOK_PAWN_1;
+        else if(progression == 2)
+            safetyIssues += ROOK_PAWN_2;
+        else if(progression > 2)
+            safetyIssues += ROOK_PAWN_FAR;
+    }
+
+    //Knight Pawn
+    //If the pawn on the knight's file is absent or far away
+    //the state is penalized
+    fileInfo = isOpenFile(pawns, knightFile, color);
+    if(fileInfo < 0)
+        safetyIssues += KNIGHT_PAWN_MISSING;
+    if(fileInfo == -2)
+        safetyIssues += KNIGHT_PAWN_OPEN;
+    else
+    {
+        progression = pawnProgression(pawns, knightFile, color);
+        if(progression == 1)
+            safetyIssues += KNIGHT_PAWN_1;
+        else if(progression == 2)
+            safetyIssues += KNIGHT_PAWN_2;
+        else if(progression > 2)
+            safetyIssues += KNIGHT_PAWN_FAR;
+    }
 
-        //Knight Pawn
-        fileInfo = isOpenFile(knightFile, white);
-        if(fileInfo < 0)
-            safetyIssues += KNIGHT_PAWN_MISSING;
-        if(fileInfo == -2)
-            safetyIssues += KNIGHT_PAWN_OPEN;
+    //Bishop Pawn
+    //If the pawn on the bishop's file is absent or far away
+    //the state is penalized
+    if(safetyIssues > 1)
+    {
+        fileInfo = isOpenFile(pawns, bishopFile, color);
+        if(abs(fileInfo) == 2)
+            safetyIssues += BISHOP_PAWN_MISSING;
         else
         {
-            progression = pawnProgression(knightFile, white);
+            progression = pawnProgression(pawns, bishopFile, color);
             if(progression == 1)
-                safetyIssues += KNIGHT_PAWN_1;
+                safetyIssues += BISHOP_PAWN_1;
             else if(progression == 2)
-                safetyIssues += KNIGHT_PAWN_2;
+                safetyIssues += BISHOP_PAWN_2;
             else if(progression > 2)
-                safetyIssues += KNIGHT_PAWN_FAR;
-        }
-
-        //Bishop Pawn
-        if(safetyIssues > 1)
-        {
-            fileInfo = isOpenFile(bishopFile, white);
-            if(abs(fileInfo) == 2)
-                safetyIssues += BISHOP_PAWN_MISSING;
-            else
-            {
-                progression = pawnProgression(bishopFile, white);
-                if(progression == 1)
-                    safetyIssues += BISHOP_PAWN_1;
-                else if(progression == 2)
-                    safetyIssues += BISHOP_PAWN_2;
-                else if(progression > 2)
-                    safetyIssues += BISHOP_PAWN_FAR;
-            }
-        }
-
-        //check for pawn at g3/b3 that can break barrier
-        for(unsigned int i = 0; i < white->opponent->pieces.size(); i++)
-        {
-            if(white->opponent->pieces[i]->rank == 3 && white->opponent->pieces[i]->file == knightFile)
-            {
-                safetyIssues += PAWN_ATTACK_BARRIER;
-                break;
-            }
+                safetyIssues += BISHOP_PAWN_FAR;
         }
+    }
 
-        //penalize king for not being near the corner and for being exactly in corner
-        file = fileToInt(king->file);
-        if((file > 2) && (file < 7)) safetyIssues += NOT_CORNER;
-        if((file > 3) && (file < 6)) safetyIssues += NOT_CORNER;
+    //Pawn storm
+    //Enemy pawns advancing on the files in front of the king threaten to open them
+    int enemy = 1 - color;
+    safetyIssues += PAWN_STORM[pawns.frontRank[enemy][rookFile - 1]];
+    safetyIssues += PAWN_STORM[pawns.frontRank[enemy][knightFile - 1]];
+    safetyIssues += PAWN_STORM[pawns.frontRank[enemy][bishopFile - 1]];
 
-        if(king->rank > 1) safetyIssues += NOT_CORNER;
-        if(king->rank > 2) safetyIssues += NOT_CORNER;
-        if(king->rank > 3) safetyIssues += NOT_CORNER;
-        if(king->rank == 1 && (file == 1 || file == 8))
-            safetyIssues += IN_CORNER;
-    }
+    //check for an enemy pawn on the knight's file three ranks in front of the
+    //king, the enemy's sixth rank, that can break the barrier
+    if(pawns.backRank[enemy][knightFile - 1] == 6 || pawns.frontRank[enemy][knightFile - 1] == 6)
+        safetyIssues += PAWN_ATTACK_BARRIER;
 
     return safetyIssues;
 }
 
 //Generates all moves that the pointed piece can make
-vector<action> state::generateKingMoves(myPiece* king)
+void state::generateKingMoves(myPiece* king, vector<action>& result)
 {
-    vector<action> result;
     const int DIRECTIONS = 8;
     int modRank;
     int modFile;
@@ -1264,38 +1549,25 @@ vector<action> state::generateKingMoves(myPiece* king)
         currentPlayer = king->owner->opponent;
     }
 
-    return result;
 }
 
 //Generates all moves that the pointed piece can make
-vector<action> state::generateQueenMoves(myPiece* queen)
+void state::generateQueenMoves(myPiece* queen, vector<action>& actions)
 {
-    vector<action> actions;
-    vector<action> newMoves;
-
-    //generate Rook moves and add them to the total actions
-    newMoves = generateRookMoves(queen);
-    for(unsigned int i = 0; i < newMoves.size(); i++)
-    {
-        newMoves[i].type = "Queen";
-        actions.push_back(newMoves[i]);
-    }
+    unsigned int first = actions.size();
 
-    //generate Bishop moves and add them to the total actions
-    newMoves = generateBishopMoves(queen);
-    for(unsigned int i = 0; i < newMoves.size(); i++)
+    //generate Rook and Bishop moves and add them to the total actions
+    generateRookMoves(queen, actions);
+    generateBishopMoves(queen, actions);
+    for(unsigned int i = first; i < actions.size(); i++)
     {
-        newMoves[i].type = "Queen";
-        actions.push_back(newMoves[i]);
+        actions[i].type = "Queen";
     }
-
-    return actions;
 }
 
 //Generates all moves that the pointed piece can make
-vector<action> state::generateKnightMoves(myPiece* knight)
+void state::generateKnightMoves(myPiece* knight, vector<action>& result)
 {
-    vector<action> result;
     const int DIRECTIONS = 8;
     int modRank;
     int modFile;
@@ -1378,13 +1650,11 @@ vector<action> state::generateKnightMoves(myPiece* knight)
     {
         currentPlayer = knight->owner->opponent;
     }
-    return result;
 }
 
 //Generates all moves that the pointed piece can make
-vector<action> state::generateRookMoves(myPiece* rook)
+void state::generateRookMoves(myPiece* rook, vector<action>& result)
 {
-    vector<action> result;
     const int DIRECTIONS = 4;
     int modRank;
     int modFile;
@@ -1463,13 +1733,11 @@ vector<action> state::generateRookMoves(myPiece* rook)
     {
         currentPlayer = rook->owner->opponent;
     }
-    return result;
 }
 
 //Generates all moves that the pointed piece can make
-vector<action> state::generateBishopMoves(myPiece* bishop)
+void state::generateBishopMoves(myPiece* bishop, vector<action>& result)
 {
-    vector<action> result;
     const int DIRECTIONS = 4;
     int modRank;
     int modFile;
@@ -1548,14 +1816,18 @@ vector<action> state::generateBishopMoves(myPiece* bishop)
     {
         currentPlayer = bishop->owner->opponent;
     }
-    return result;
 }
 
 
-//Generates all moves that the pointed piece can make
-vector<action> state::generatePawnMoves(myPiece* pawn)
+//Generates all moves that the pointed pawn of Color can make
+template <int Color>
+void state::generatePawnMoves(myPiece* pawn, vector<action>& actions)
 {
-    vector<action> actions;
+    const int DIRECTION = (Color == 0) ? 1 : -1;
+    const int START_RANK = (Color == 0) ? 2 : 7;
+    const int EN_PASSANT_RANK = (Color == 0) ? 5 : 4;
+    const int PROMOTION_RANK = (Color == 0) ? 8 : 1;
+
     action tmp;
     tmp.oldFile = pawn->file;
     tmp.oldRank = pawn->rank;
@@ -1578,34 +1850,18 @@ vector<action> state::generatePawnMoves(myPiece* pawn)
     //store file as integer for easy manipulation
     int tmpFile = fileToInt(pawn->file);
 
-    //en passant white
-    if(currentPlayer->rankDirection == 1 && pawn->rank == 5)
-    {
-        if(previousActions.back().type == "Pawn" &&
-           previousActions.back().oldRank == 7 && previousActions.back().newRank == 5 &&
-           (fileToInt(previousActions.back().newFile) == tmpFile+1 ||
-            fileToInt(previousActions.back().newFile) == tmpFile-1))
-        {
-            tmp.isEnPassant = true;
-            tmp.newFile = previousActions.back().newFile;
-            tmp.newRank = pawn->rank + currentPlayer->rankDirection;
-            if(validForCheck(ownPiece, tmp))
-                actions.push_back(tmp);
-        }
-    }
-    tmp.isEnPassant = false;
-
-    //en passant black
-    if(currentPlayer->rankDirection == -1 && pawn->rank == 4)
+    //en passant, after an opponent's pawn passed this one with a double step
+    if(pawn->rank == EN_PASSANT_RANK)
     {
-        if(previousActions.back().type == "Pawn" &&
-           previousActions.back().oldRank == 2 && previousActions.back().newRank == 4 &&
+        if(!previousActions.empty() && previousActions.back().type == "Pawn" &&
+           previousActions.back().oldRank == EN_PASSANT_RANK + 2 * DIRECTION &&
+           previousActions.back().newRank == EN_PASSANT_RANK &&
            (fileToInt(previousActions.back().newFile) == tmpFile+1 ||
             fileToInt(previousActions.back().newFile) == tmpFile-1))
         {
             tmp.isEnPassant = true;
             tmp.newFile = previousActions.back().newFile;
-            tmp.newRank = pawn->rank + currentPlayer->rankDirection;
+            tmp.newRank = pawn->rank + DIRECTION;
             if(validForCheck(ownPiece, tmp))
                 actions.push_back(tmp);
         }
@@ -1613,12 +1869,12 @@ vector<action> state::generatePawnMoves(myPiece* pawn)
     tmp.isEnPassant = false;
 
     //forward movement check
-    if(occupied(pawn->rank + currentPlayer->rankDirection, tmpFile, currentPlayer) == 0)
+    if(occupied(pawn->rank + DIRECTION, tmpFile, currentPlayer) == 0)
     {
         tmp.newFile = pawn->file;
-        tmp.newRank = pawn->rank + currentPlayer->rankDirection;
+        tmp.newRank = pawn->rank + DIRECTION;
         //promotion check
-        if(tmp.newRank == 8 || tmp.newRank == 1)
+        if(tmp.newRank == PROMOTION_RANK)
         {
             tmp.promotion = "Queen";
         }
@@ -1631,12 +1887,11 @@ vector<action> state::generatePawnMoves(myPiece* pawn)
             actions.push_back(tmp);
 
         //check if first move can be 2 spaces
-        if(occupied(pawn->rank + (currentPlayer->rankDirection * 2), tmpFile, currentPlayer) == 0
-           && pawn->hasMoved == false && ((currentPlayer->rankDirection == 1 && pawn->rank == 2) ||
-           (currentPlayer->rankDirection == -1 && pawn->rank == 7)))
+        if(occupied(pawn->rank + (DIRECTION * 2), tmpFile, currentPlayer) == 0
+           && pawn->hasMoved == false && pawn->rank == START_RANK)
         {
             tmp.newFile = pawn->file;
-            tmp.newRank = pawn->rank + (currentPlayer->rankDirection * 2);
+            tmp.newRank = pawn->rank + (DIRECTION * 2);
             tmp.promotion = "";
             if(validForCheck(ownPiece, tmp))
                 actions.push_back(tmp);
@@ -1644,13 +1899,13 @@ vector<action> state::generatePawnMoves(myPiece* pawn)
     }
 
     //capture check right
-    if((occupied(pawn->rank + currentPlayer->rankDirection, tmpFile + 1, currentPlayer) == -1 &&
+    if((occupied(pawn->rank + DIRECTION, tmpFile + 1, currentPlayer) == -1 &&
        tmpFile + 1 <= 8) || !ownPiece)
     {
         tmp.newFile = intToFile(tmpFile+1);
-        tmp.newRank = pawn->rank + currentPlayer->rankDirection;
+        tmp.newRank = pawn->rank + DIRECTION;
         //promotion check
-        if(tmp.newRank == 8 || tmp.newRank == 1)
+        if(tmp.newRank == PROMOTION_RANK)
         {
             tmp.promotion = "Queen";
         }
@@ -1663,13 +1918,13 @@ vector<action> state::generatePawnMoves(myPiece* pawn)
     }
 
     //capture check left
-    if((occupied(pawn->rank + currentPlayer->rankDirection, tmpFile - 1, currentPlayer) == -1 &&
+    if((occupied(pawn->rank + DIRECTION, tmpFile - 1, currentPlayer) == -1 &&
        tmpFile - 1 >= 1) || !ownPiece)
     {
         tmp.newFile = intToFile(tmpFile-1);
-        tmp.newRank = pawn->rank + currentPlayer->rankDirection;
+        tmp.newRank = pawn->rank + DIRECTION;
         //promotion check
-        if(tmp.newRank == 8 || tmp.newRank == 1)
+        if(tmp.newRank == PROMOTION_RANK)
         {
             tmp.promotion = "Queen";
         }
@@ -1686,7 +1941,6 @@ vector<action> state::generatePawnMoves(myPiece* pawn)
     {
         currentPlayer = pawn->owner->opponent;
     }
-    return actions;
 }
 
 //Returns 1 if the space contains a friendly piece
@@ -1886,10 +2140,13 @@ bool state::inDanger(const int rank, const int file, const myPlayer* player)
 //returns false if the action results in check for the current player
 bool state::validForCheck(bool isOwnPiece, action a)
 {
-    state test;
+    //each thread keeps one board for testing moves so no pieces are allocated per move,
+    //and the board never evaluates so it does without the network's accumulators
+    static thread_local state test;
     if(isOwnPiece)
     {
-        test = result(a, false, 0, false, false);
+        test.skipsAccumulators = true;
+        resultInto(test, a, false, 0, false, 0);
         if(!test.isCheck(test.currentPlayer->opponent))
             return true;
     }
@@ -1942,31 +2199,15 @@ bool state::isDraw()
     return true;
 }
 
-//returns whether the targetFile is open
+//returns whether the file (1-8) is open for color
 //return value of 2 is a file with only opponent pawns
 //return value of 1 is a file with both player's pawns
 //return value of -1 is a file with only the player's pawns
 //return value of -2 is a file with no pawns
-int state::isOpenFile(string targetFile, myPlayer* player)
+int state::isOpenFile(pawnEntry& pawns, int file, int color)
 {
-    bool playerPawns = false;
-    bool opponentPawns = false;
-    for(unsigned int i = 0; i < player->pieces.size(); i++)
-    {
-        if(player->pieces[i]->type == "Pawn" && player->pieces[i]->file == targetFile)
-        {
-            playerPawns = true;
-            break;
-        }
-    }
-    for(unsigned int i = 0; i < player->opponent->pieces.size(); i++)
-    {
-        if(player->opponent->pieces[i]->type == "Pawn" && player->opponent->pieces[i]->file == targetFile)
-        {
-            opponentPawns = true;
-            break;
-        }
-    }
+    bool playerPawns = (pawns.files[color] & (1 << (file - 1))) != 0;
+    bool opponentPawns = (pawns.files[1 - color] & (1 << (file - 1))) != 0;
     if(playerPawns && opponentPawns)
     {
         return 1;
@@ -1979,90 +2220,16 @@ int state::isOpenFile(string targetFile, myPlayer* player)
     {
         return -1;
     }
-    if(!playerPawns && !opponentPawns)
-    {
-        return -2;
-    }
-    return 0;
-}
-
-//returns how far a pawn has progressed in a given file
-int state::pawnProgression(string targetFile, myPlayer* player)
-{
-    for(unsigned int i = 0; i < player->pieces.size(); i++)
-    {
-        if(player->pieces[i]->type == "Pawn" && player->pieces[i]->file == targetFile)
-        {
-            if(player->rankDirection == 1)
-                return player->pieces[i]->rank - 2;
-            else
-                return 7 - player->pieces[i]->rank;
-        }
-    }
-    return 0;
+    return -2;
 }
 
-//This function returns the number of squares around the king which are invalid for
-//the king to move to. It is not yet used in the utility function.
-int state::pinnedSquares(const myPlayer* player)
+//returns how far color's least advanced pawn has progressed in a given file
+int state::pawnProgression(pawnEntry& pawns, int file, int color)
 {
-    int modFile;
-    int modRank;
-    int numberPinned=0;
-    unsigned int i = 0;
-    //find index of player king
-    while(i < player->pieces.size() && player->pieces[i]->type != "King")
-    {
-        i++;
-    }
-    int file = fileToInt(player->pieces[i]->file);
-    for(int j = 0; j < 8; j++)
-    {
-        switch (j)
-        {
-            case 0:
-                modFile = -1;
-                modRank = -1;
-                break;
-            case 1:
-                modFile = 0;
-                modRank = -1;
-                break;
-            case 2:
-                modFile = 1;
-                modRank = -1;
-                break;
-            case 3:
-                modFile = 1;
-                modRank = 0;
-                break;
-            case 4:
-                modFile = 1;
-                modRank = 1;
-                break;
-            case 5:
-                modFile = 0;
-                modRank = 1;
-                break;
-            case 6:
-                modFile = -1;
-                modRank = 1;
-                break;
-            case 7:
-                modFile = -1;
-                modRank = 0;
-                break;
-        }
-
-        if(file+modFile >= 1 && file+modFile <= 8 &&
-           player->pieces[i]->rank+modRank >= 1 && player->pieces[i]->rank+modRank <= 8 &&
-           (inDanger(player->pieces[i]->rank+modRank, file+modFile, player) ||
-            occupied(player->pieces[i]->rank+modRank, file+modFile, player) == 1))
-        {
-            numberPinned++;
-        }
-    }
-    return numberPinned;
+    int rank = pawns.backRank[color][file - 1];
+    if(rank == 0)
+        return 0;
+    return rank - 2;
 }
 
 //Removes the piece that is at the given rank/file combination
@@ -2070,7 +2237,6 @@ void state::removeTakenPiece(const int rank, const string file)
 {
 	unsigned int i = 0;
     int positionRemoved = -1;
-    int materialChange = 0;
     //find index of removed piece
     while(i < currentPlayer->opponent->pieces.size() && positionRemoved == -1)
     {
@@ -2082,32 +2248,11 @@ void state::removeTakenPiece(const int rank, const string file)
         i++;
     }
 
-    switch(currentPlayer->opponent->pieces[positionRemoved]->type[0])
-    {
-    	case 'Q':
-    		materialChange = QUEENVALUE;
-    		break;
-    	case 'R':
-    		materialChange = ROOKVALUE;
-    		break;
-    	case 'P':
-    		materialChange = PAWNVALUE;
-    		break;
-    	case 'K':
-    		materialChange = KNIGHTVALUE;
-    		break;
-    	case 'B':
-    		materialChange = BISHOPVALUE;
-    }
-
-    if(currentPlayer == maxPlayer)
-    {
-    	materialDifference += materialChange;
-    }
-    else
-    {
-    	materialDifference -= materialChange;
-    }
+    //remove the taken piece from the Zobrist key and the scores
+    int color = (currentPlayer->opponent->rankDirection == 1) ? 0 : 1;
+    int type = pieceIndex(currentPlayer->opponent->pieces[positionRemoved]->type);
+    hashKey ^= zobristPieces[color][type][squareIndex(rank, file)];
+    addPieceScores(color, type, squareIndex(rank, file), -1);
 
     //delete removed piece from state
     delete currentPlayer->opponent->pieces[positionRemoved];
@@ -2136,6 +2281,260 @@ string state::getType(const int rank, const string file)
     return "";
 }
 
+//Fills the Zobrist key tables with pseudo random numbers. A fixed seed keeps
+//keys identical between runs so search results are reproducible.
+bool state::initializeZobrist()
+{
+    unsigned long long seed = 0x9E3779B97F4A7C15ULL;
+    auto next = [&seed]()
+    {
+        unsigned long long z = (seed += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    };
+
+    for(int color = 0; color < 2; color++)
+        for(int type = 0; type < 6; type++)
+            for(int square = 0; square < 64; square++)
+                zobristPieces[color][type][square] = next();
+    //no castling rights and no en passant file leave the key unchanged
+    zobristCastling[0] = 0;
+    for(int i = 1; i < 16; i++)
+        zobristCastling[i] = next();
+    zobristEnPassant[0] = 0;
+    for(int i = 1; i < 9; i++)
+        zobristEnPassant[i] = next();
+    zobristBlackToMove = next();
+    return true;
+}
+
+//Recalculates the Zobrist key from scratch. This is only needed when a state
+//is set up directly rather than being produced by result()
+void state::calculateHash()
+{
+    static const bool zobristReady = initializeZobrist();
+    (void)zobristReady;
+
+    calculateCastlingRights();
+    hashKey = 0;
+    for(unsigned int p = 0; p < players.size(); p++)
+    {
+        int color = (players[p]->rankDirection == 1) ? 0 : 1;
+        for(unsigned int i = 0; i < players[p]->pieces.size(); i++)
+        {
+            myPiece* piece = players[p]->pieces[i];
+            hashKey ^= zobristPieces[color][pieceIndex(piece->type)][squareIndex(piece->rank, piece->file)];
+        }
+    }
+    hashKey ^= zobristCastling[castlingRights] ^ zobristEnPassant[enPassantFile()];
+    if(currentPlayer->rankDirection == -1)
+        hashKey ^= zobristBlackToMove;
+}
+
+//Determines the castling rights from the unmoved kings and rooks on their starting squares
+void state::calculateCastlingRights()
+{
+    castlingRights = 0;
+    for(unsigned int p = 0; p < players.size(); p++)
+    {
+        int homeRank = (players[p]->rankDirection == 1) ? 1 : 8;
+        int shift = (players[p]->rankDirection == 1) ? 0 : 2;
+        bool kingHome = false;
+        int rookRights = 0;
+        for(unsigned int i = 0; i < players[p]->pieces.size(); i++)
+        {
+            myPiece* piece = players[p]->pieces[i];
+            if(piece->hasMoved || piece->rank != homeRank)
+                continue;
+            if(piece->type == "King" && piece->file == "e")
+                kingHome = true;
+            else if(piece->type == "Rook" && piece->file == "h")
+                rookRights |= 1;
+            else if(piece->type == "Rook" && piece->file == "a")
+                rookRights |= 2;
+        }
+        if(kingHome)
+            castlingRights |= rookRights << shift;
+    }
+}
+
+//Returns the file (1-8) of a pawn that just advanced two ranks and can therefore
+//be captured en passant, or 0 if the previous action was not a double pawn move
+int state::enPassantFile()
+{
+    if(previousActions.empty())
+        return 0;
+    action& last = previousActions.back();
+    if(last.type == "Pawn" && abs(last.newRank - last.oldRank) == 2)
+        return fileToInt(last.newFile);
+    return 0;
+}
+
+//Returns the index of a piece type in the Zobrist tables
+int state::pieceIndex(const string& type)
+{
+    switch(type[0])
+    {
+        case 'P':
+            return 0;
+        case 'B':
+            return 2;
+        case 'R':
+            return 3;
+        case 'Q':
+            return 4;
+        case 'K':
+            //both King and Knight start with K
+            return (type[1] == 'n') ? 1 : 5;
+    }
+    return 0;
+}
+
+//Returns the 0-63 index of a square with a1 as 0 and h8 as 63
+int state::squareIndex(const int rank, const string& file)
+{
+    return (rank - 1) * 8 + (file[0] - 'a');
+}
+
+//Recalculates the material and piece-square scores and the pawn key from scratch.
+//Like the Zobrist key this is only needed when a state is set up directly, and it
+//must follow calculateHash() which fills in the Zobrist tables.
+void state::calculateScores()
+{
+    for(int color = 0; color < 2; color++)
+    {
+        material[color] = 0;
+        psqMidgame[color] = 0;
+        psqEndgame[color] = 0;
+    }
+    phaseMaterial = 0;
+    pawnKey = 0;
+    accumulatorValid[0] = false;
+    accumulatorValid[1] = false;
+    for(unsigned int p = 0; p < players.size(); p++)
+    {
+        int color = (players[p]->rankDirection == 1) ? 0 : 1;
+        for(unsigned int i = 0; i < players[p]->pieces.size(); i++)
+        {
+            myPiece* piece = players[p]->pieces[i];
+            addPieceScores(color, pieceIndex(piece->type), squareIndex(piece->rank, piece->file), 1);
+        }
+    }
+}
+
+void state::setWeights(const evalWeights& w)
+{
+    weights = w;
+    weightsGeneration++;
+    lazyMidgameMargin = midgameMargin();
+    lazyEndgameMargin = endgameMargin();
+}
+
+//Returns how far the two rooks of a side can move rookUtility() under the weights
+static int rookSpan(const evalWeights& w)
+{
+    int fileSpan = max({0, w.rookOpenFile, w.rookOpenFile + w.rookConnectedOpenFile, w.rookHalfOpenFile}) -
+                   min({0, w.rookOpenFile, w.rookOpenFile + w.rookConnectedOpenFile, w.rookHalfOpenFile});
+    int rankSpan = max({0, w.rookOn7, w.rookOn7 + w.rookConnectedOn7}) -
+                   min({0, w.rookOn7, w.rookOn7 + w.rookConnectedOn7});
+    return 2 * (fileSpan + rankSpan);
+}
+
+//Returns the bound of the midgame terms evaluate() skips: the king safety, the
+//queen's bonus against a weak king, the development and castling terms, the rooks
+//and ACTIVITY_LIMIT. The terms of each side lie in a range, so the difference of the
+//two sides is bounded by the width of that range.
+int state::midgameMargin()
+{
+    //kingSafetyUtility() uses no weights, so its bound is fixed
+    const int KING_SAFETY_BOUND = 3840;
+    //the knights, bishops and d and e pawns openingUtility() looks at
+    const int DEVELOPING_PIECES = 6;
+
+    const evalWeights& w = weights;
+    int developmentSpan = DEVELOPING_PIECES * (max({0, w.unmovedPenalty, w.unmovedPenalty + w.nudge}) -
+                                               min({0, w.unmovedPenalty, w.unmovedPenalty + w.nudge}));
+    //the castling term counts cantCastle for each moved rook and the moved king
+    int castlingSpan = max({w.castled, w.notYetCastle, w.notYetCastle + 3 * w.cantCastle}) -
+                       min({w.castled, w.notYetCastle, w.notYetCastle + 3 * w.cantCastle});
+    int openingSpan = developmentSpan + abs(w.queenIsEarly) + castlingSpan;
+    return KING_SAFETY_BOUND + abs(w.queenBonusWeakKing) + openingSpan + rookSpan(w) + ACTIVITY_LIMIT;
+}
+
+//Returns the bound of the endgame terms evaluate() skips: the rooks, the corner
+//chase and ACTIVITY_LIMIT
+int state::endgameMargin()
+{
+    //endingUtility() counts at most 6 squares to a corner at 10 each
+    const int CORNER_CHASE_BOUND = 60;
+
+    return rookSpan(weights) + CORNER_CHASE_BOUND + ACTIVITY_LIMIT;
+}
+
+//Adds (sign 1) or removes (sign -1) the scores of a piece of type on square,
+//along with a pawn's part of the pawn key and the piece's network features
+void state::addPieceScores(int color, int type, int square, int sign)
+{
+    const int values[6] = {weights.pawnValue, weights.knightValue, weights.bishopValue,
+                            weights.rookValue, weights.queenValue, 0};
+    const int phases[6] = {0, 1, 1, 2, 4, 0};
+    if(type == 0)
+        pawnKey ^= zobristPieces[color][0][square];
+    if(type == 5)
+        accumulatorValid[color] = false;
+    else
+    {
+        for(int perspective = 0; perspective < 2; perspective++)
+        {
+            if(!accumulatorValid[perspective])
+                continue;
+            int feature = nnue::featureIndex(perspective, accumulatorKing[perspective], color, type, square);
+            if(sign > 0)
+                nnue::network().addFeature(accumulator[perspective], feature);
+            else
+                nnue::network().subtractFeature(accumulator[perspective], feature);
+        }
+    }
+    if(color == 1)
+        square ^= 56;
+    material[color] += sign * values[type];
+    phaseMaterial += sign * phases[type];
+    psqMidgame[color] += sign * PSQ_SCALE * PSQ_MIDGAME[type][square];
+    psqEndgame[color] += sign * PSQ_SCALE * PSQ_ENDGAME[type][square];
+}
+
+//Rebuilds perspective's accumulator from the pieces on the board for the square
+//its king stands on now
+void state::refreshAccumulator(int perspective)
+{
+    nnue& network = nnue::network();
+    network.resetAccumulator(accumulator[perspective]);
+    for(unsigned int p = 0; p < players.size(); p++)
+    {
+        int color = (players[p]->rankDirection == 1) ? 0 : 1;
+        for(unsigned int i = 0; i < players[p]->pieces.size(); i++)
+        {
+            myPiece* piece = players[p]->pieces[i];
+            if(piece->type == "King" && color == perspective)
+                accumulatorKing[perspective] = squareIndex(piece->rank, piece->file);
+        }
+    }
+    for(unsigned int p = 0; p < players.size(); p++)
+    {
+        int color = (players[p]->rankDirection == 1) ? 0 : 1;
+        for(unsigned int i = 0; i < players[p]->pieces.size(); i++)
+        {
+            myPiece* piece = players[p]->pieces[i];
+            int type = pieceIndex(piece->type);
+            if(type != 5)
+                network.addFeature(accumulator[perspective], nnue::featureIndex(perspective,
+                                   accumulatorKing[perspective], color, type, squareIndex(piece->rank, piece->file)));
+        }
+    }
+    accumulatorValid[perspective] = true;
+}
+
 //converts the file into an integer
 int state::fileToInt(string file)
 {
@@ -2355,6 +2754,161 @@ void game::initializeBoard()
 	tmp->owner = current_state.players[1];
 	tmp->type = "King";
 	current_state.players[1]->pieces.push_back(tmp);
+
+	current_state.calculateHash();
+	current_state.calculateScores();
+}
+
+//Sets up the current_state from a position in Forsyth-Edwards Notation. Pieces
+//are marked as unmoved when they stand on their starting squares, kings and rooks
+//only when the castling field allows it. An en passant square becomes the double
+//pawn move that allowed it. Returns false if the piece placement cannot be read.
+bool game::loadFEN(const string& fen)
+{
+	istringstream fields(fen);
+	string placement, toMove, castling, enPassant;
+	int halfMoves = 0, fullMoves = 1;
+
+	fields >> placement >> toMove >> castling >> enPassant >> halfMoves >> fullMoves;
+	if(placement.empty())
+		return false;
+
+	for(unsigned int p = 0; p < current_state.players.size(); p++)
+	{
+		for(unsigned int i = 0; i < current_state.players[p]->pieces.size(); i++)
+			delete current_state.players[p]->pieces[i];
+		current_state.players[p]->pieces.clear();
+	}
+	current_state.previousActions.clear();
+
+	int rank = 8;
+	int file = 1;
+	for(unsigned int i = 0; i < placement.size(); i++)
+	{
+		char c = placement[i];
+		if(c == '/')
+		{
+			rank--;
+			file = 1;
+			continue;
+		}
+		if(c >= '1' && c <= '8')
+		{
+			file += c - '0';
+			continue;
+		}
+		if(rank < 1 || file > 8)
+			return false;
+
+		myPiece* tmp;
+		tmp = new myPiece;
+		bool isWhite = (c >= 'A' && c <= 'Z');
+		int homeRank = isWhite ? 1 : 8;
+		tmp->rank = rank;
+		tmp->file = current_state.intToFile(file);
+		tmp->owner = current_state.players[isWhite ? 0 : 1];
+		switch(toupper(c))
+		{
+			case 'P':
+				tmp->type = "Pawn";
+				tmp->hasMoved = (rank != (isWhite ? 2 : 7));
+				break;
+			case 'N':
+				tmp->type = "Knight";
+				tmp->hasMoved = !(rank == homeRank && (file == 2 || file == 7));
+				break;
+			case 'B':
+				tmp->type = "Bishop";
+				tmp->hasMoved = !(rank == homeRank && (file == 3 || file == 6));
+				break;
+			case 'R':
+				tmp->type = "Rook";
+				tmp->hasMoved = !(rank == homeRank &&
+				                  ((file == 8 && castling.find(isWhite ? 'K' : 'k') != string::npos) ||
+				                   (file == 1 && castling.find(isWhite ? 'Q' : 'q') != string::npos)));
+				break;
+			case 'Q':
+				tmp->type = "Queen";
+				tmp->hasMoved = !(rank == homeRank && file == 4);
+				break;
+			case 'K':
+				tmp->type = "King";
+				tmp->hasMoved = !(rank == homeRank && file == 5 &&
+				                  castling.find_first_of(isWhite ? "KQ" : "kq") != string::npos);
+				break;
+			default:
+				delete tmp;
+				return false;
+		}
+		tmp->owner->pieces.push_back(tmp);
+		file++;
+	}
+
+	current_state.currentPlayer = current_state.players[(toMove == "b") ? 1 : 0];
+	current_state.maxPlayer = current_state.currentPlayer;
+	current_state.isTerminalState = false;
+
+	//every side needs exactly one king, and the player who just moved cannot have
+	//left its king in check
+	for(unsigned int p = 0; p < current_state.players.size(); p++)
+	{
+		int kings = 0;
+		for(unsigned int i = 0; i < current_state.players[p]->pieces.size(); i++)
+		{
+			if(current_state.players[p]->pieces[i]->type == "King")
+				kings++;
+		}
+		if(kings != 1)
+			return false;
+	}
+	if(current_state.isCheck(current_state.currentPlayer->opponent))
+		return false;
+
+	//a king standing beside its home corner without castling rights has most likely castled
+	current_state.whiteHasCastled = false;
+	current_state.blackHasCastled = false;
+	for(unsigned int p = 0; p < current_state.players.size(); p++)
+	{
+		int homeRank = (p == 0) ? 1 : 8;
+		for(unsigned int i = 0; i < current_state.players[p]->pieces.size(); i++)
+		{
+			myPiece* piece = current_state.players[p]->pieces[i];
+			if(piece->type == "King" && piece->hasMoved && piece->rank == homeRank &&
+			   (piece->file == "g" || piece->file == "c"))
+			{
+				if(p == 0)
+					current_state.whiteHasCastled = true;
+				else
+					current_state.blackHasCastled = true;
+			}
+		}
+	}
+
+	if(enPassant.size() == 2 && enPassant[0] >= 'a' && enPassant[0] <= 'h')
+	{
+		action doublePush;
+		doublePush.type = "Pawn";
+		doublePush.oldFile = enPassant.substr(0, 1);
+		doublePush.newFile = doublePush.oldFile;
+		if(current_state.currentPlayer->rankDirection == 1)
+		{
+			doublePush.oldRank = 7;
+			doublePush.newRank = 5;
+		}
+		else
+		{
+			doublePush.oldRank = 2;
+			doublePush.newRank = 4;
+		}
+		current_state.previousActions.push_back(doublePush);
+	}
+
+	current_state.calculateHash();
+	current_state.calculateScores();
+	current_state.updateMaterialDifference();
+	currentTurn = (fullMoves - 1) * 2 + ((toMove == "b") ? 1 : 0);
+	move_log.clear();
+	return true;
 }
 
 //return true if the move is valid and false otherwise
@@ -2373,11 +2927,49 @@ bool game::valid_move(action move)
 //Updates the game's current state and increments the turn counter
 void game::update(action move)
 {
-	current_state = current_state.result(move, false, 0, false, false);
+	current_state = current_state.result(move, false, 0, false);
 	currentTurn++;
 	return;
 }
 
+//Sets both clocks to seconds with inc seconds added after each move and
+//seconds added again every moves moves (0 for sudden death)
+void game::setTimeControl(double seconds, double inc, int moves)
+{
+	timeAllowed = seconds;
+	increment = inc;
+	movesPerControl = moves;
+	whiteTimeRemaining = seconds;
+	blackTimeRemaining = seconds;
+}
+
+//Returns the number of moves left before the next time control for the player
+//moving turnsAhead turns from now, or 0 if the game is played in sudden death
+int game::movesToGo(int turnsAhead)
+{
+	if(movesPerControl <= 0)
+		return 0;
+	//a player has made turn/2 moves before making the move of turn
+	int movesMade = (currentTurn + turnsAhead) / 2;
+	return movesPerControl - (movesMade % movesPerControl);
+}
+
+//Adds the increment, and the time for a new control when one is reached, to the
+//clock of the player who just moved. Called after update(), and only when the
+//mover's clock did not run out during the move, since that loses the game.
+void game::addTimeControlBonus(int rankDirection)
+{
+	double bonus = increment;
+	//the mover has made (currentTurn+1)/2 moves as white or currentTurn/2 as black
+	int movesMade = (rankDirection == 1) ? (currentTurn + 1) / 2 : currentTurn / 2;
+	if(movesPerControl > 0 && movesMade % movesPerControl == 0)
+		bonus += timeAllowed;
+	if(rankDirection == 1)
+		whiteTimeRemaining += bonus;
+	else
+		blackTimeRemaining += bonus;
+}
+
 //returns the associated return code for why a game ended or if it
 //is not yet over
 int game::is_game_over()
@@ -10,9 +10,25 @@
 #include <iostream>
 #include <time.h>
 #include <queue>
+#include <chrono>
+#include <climits>
+#include "pawnTable.h"
+#include "nnue.h"
+#include "attackMap.h"
+#include "evalWeights.h"
 
 using namespace std;
 
+//All time accounting uses a monotonic wall clock. Process CPU time would grow
+//faster than real time while several search threads run.
+typedef chrono::steady_clock gameClock;
+
+//Returns the seconds passed since start with sub-millisecond resolution
+inline double secondsSince(gameClock::time_point start)
+{
+    return chrono::duration<double>(gameClock::now() - start).count();
+}
+
 class myPlayer;
 
 //The action class maintain information about a chess move including information
@@ -31,13 +47,15 @@ class action
         //Values defining the actions status in an AI history table
         int historyValue;
         int htAge;
+        //Priority used by the AI to decide the order actions are searched in
+        int orderValue;
         //Flags noting special cases of piece behavior
         bool isCastle;
         bool isEnPassant;
 
-        action() {isCastle = false; isEnPassant = false; historyValue = 0; htAge = 0;}
+        action() {isCastle = false; isEnPassant = false; historyValue = 0; htAge = 0; orderValue = 0;}
         bool operator==(const action& rhs);
-        bool operator<(const action& rhs)const {return historyValue < rhs.historyValue;}
+        bool operator<(const action& rhs)const {return orderValue < rhs.orderValue;}
         friend ostream& operator<<(ostream& os, const action& a);
 };
 
@@ -74,16 +92,27 @@ class state
 	    const int CHECKMATEVALUE = 100000;
 	    const int DRAWVALUE = 0;
 
-	    const int END_GAME_CUTOFF = 15000;
+	    //The piece values and the other weights the tune command adjusts. Changing
+	    //them goes through setWeights() so no cached utility outlives them.
+	    static evalWeights weights;
+	    //Counts the calls to setWeights() and is part of the evaluation cache key
+	    static int weightsGeneration;
+	    //The mobility and threat terms grow with the number of pieces, so their sum is
+	    //held to ACTIVITY_LIMIT to keep them inside the lazy margins
+	    static const int ACTIVITY_LIMIT = 1500;
+	    //Bounds of the midgame and endgame terms evaluate() skips when it returns a
+	    //lazy utility. Most of them are weights, so setWeights() recomputes them.
+	    static int lazyMidgameMargin;
+	    static int lazyEndgameMargin;
+	    //Multiplies the piece-square tables into the units of the piece values
+	    const int PSQ_SCALE = 5;
 
-	    const int SAFETY_THRESH = 125;
-	    const int QUEEN_BONUS_WEAK_KING = 200;
+	    //The game phase runs from MAX_PHASE with every piece on the board down to 0
+	    //with only kings and pawns. Knights and bishops count 1, rooks 2, queens 4.
+	    static const int MAX_PHASE = 24;
 
-		const int QUEENVALUE = 9000;
-	    const int ROOKVALUE = 5000;
-	    const int BISHOPVALUE = 3200;
-	    const int KNIGHTVALUE = 3200;
-	    const int PAWNVALUE = 1000;
+	    //Size of the evaluation cache shared by all searches
+	    static const int EVAL_CACHE_MB = 4;
 
 	    //The player who is in control of the next move
         myPlayer* currentPlayer;
@@ -100,6 +129,14 @@ class state
         //A value storing the difference between the sum of the piece values
         //of the maxPlayer and the opponent's pieces
         int materialDifference = 0;
+        //The piece values and the midgame and endgame piece-square bonuses of each
+        //color (0 white, 1 black), kings excluded from the material. resultInto()
+        //and removeTakenPiece() keep them up to date so no evaluation recounts them.
+        int material[2] = {0, 0};
+        int psqMidgame[2] = {0, 0};
+        int psqEndgame[2] = {0, 0};
+        //The phase weights of the pieces still on the board
+        int phaseMaterial = 0;
         //A value storing the utility or overall value of the state
         int utilityValue;
         //A value storing how much the utility value changed since the previous state
@@ -108,36 +145,99 @@ class state
         //possible children states
         bool isTerminalState;
         //Flags signaling whether the game players have performed a castling move
-        static bool whiteHasCastled;
-        static bool blackHasCastled;
+        bool whiteHasCastled = false;
+        bool blackHasCastled = false;
+        //Bitmask of the castling moves that are still possible
+        //1: white king side, 2: white queen side, 4: black king side, 8: black queen side
+        int castlingRights = 0;
+        //Zobrist key identifying the piece placement, player to move, castling rights,
+        //and en passant file. It is updated incrementally by result() so game tree
+        //searches can recognize states they have already evaluated.
+        unsigned long long hashKey = 0;
+        //Zobrist key of the pawns alone, which indexes the pawn structure table
+        unsigned long long pawnKey = 0;
+        //First layer sums of the neural network seen by each color, and the square of
+        //that color's king they were computed for. Only evaluation strategy 2 fills
+        //them in. A valid side is updated by addPieceScores() as pieces move and is
+        //invalidated when its king moves, since every feature depends on the king.
+        short accumulator[2][nnue::HALF_DIMENSIONS];
+        bool accumulatorValid[2] = {false, false};
+        int accumulatorKing[2] = {0, 0};
+        //Set on boards that are only used to test moves. States copied into such a
+        //board leave its accumulators invalid, and resultInto() does not rebuild them.
+        bool skipsAccumulators = false;
+
+        //Random keys XOR'd together to build the Zobrist key of a state
+        static unsigned long long zobristPieces[2][6][64];
+        static unsigned long long zobristCastling[16];
+        static unsigned long long zobristEnPassant[9];
+        static unsigned long long zobristBlackToMove;
+
+        //Piece-square bonuses of white's pieces by piece index and square. Black's
+        //pieces look their squares up mirrored from rank 8 to rank 1.
+        static const int PSQ_MIDGAME[6][64];
+        static const int PSQ_ENDGAME[6][64];
 
         //Functions related to generating possible children states in the game tree
         vector<action> actions(bool existenceCheck = false);
-        state result(action& a, bool calcUtil, int strategy, bool calcTerminal, bool isOpening);
+        void actions(vector<action>& results, bool existenceCheck = false);
+        state result(action& a, bool calcUtil, int strategy, bool calcTerminal);
+        void resultInto(state& tmp, action& a, bool calcUtil, int strategy, bool calcTerminal, int utility,
+                        int alpha = INT_MIN, int beta = INT_MAX, int lazyChange = INT_MIN);
+        //The same with the strategy fixed at compile time, as used by the game tree search
+        template <int Strategy>
+        void resultInto(state& tmp, action& a, bool calcUtil, bool calcTerminal, int utility,
+                        int alpha = INT_MIN, int beta = INT_MAX, int lazyChange = INT_MIN);
 
         state();
         ~state();
 
         //Functions related to evaluating the utility or overall value of a state
-        int calculateUtility(bool isOpening, int strategy);
+        //The evaluation is compiled separately for every strategy and for every color
+        //of the max player, so each version only holds the terms it uses. The
+        //versions taking the strategy as an argument pick the compiled one.
+        int calculateUtility(int strategy, int alpha = INT_MIN, int beta = INT_MAX,
+                             int parentUtility = 0, int lazyChange = INT_MIN);
+        template <int Strategy>
+        int calculateUtility(int alpha = INT_MIN, int beta = INT_MAX,
+                             int parentUtility = 0, int lazyChange = INT_MIN);
+        template <int Strategy, int Color>
+        int evaluate(int alpha, int beta, int parentUtility, int lazyChange, bool& isExact);
+        int gamePhase();
         void updateMaterialDifference();
+        template <int Color>
         int openingUtility();
         int endingUtility();
-        int rookUtility(vector<myPiece*>& myRooks, vector<myPiece*>& oppRooks);
+        template <int Color>
+        int rookUtility(pawnEntry& pawns, vector<myPiece*>& myRooks, vector<myPiece*>& oppRooks);
         bool connected(vector<myPiece*>& rooks);
-        int rookUtilitySub(myPlayer* player, vector<myPiece*>& rooks, int enemyRank);
-        int kingSafetyUtility(myPiece* myKing, myPiece* oppKing);
-        int kingSafetyBlack(myPlayer* black, myPiece* king);
-        int kingSafetyWhite(myPlayer* white, myPiece* king);
+        template <int Color>
+        int rookUtilitySub(pawnEntry& pawns, vector<myPiece*>& rooks);
+        template <int Color>
+        int kingSafetyUtility(pawnEntry& pawns, attackMap& attacks, myPiece* myKing, myPiece* oppKing);
+        template <int Color>
+        int kingDanger(attackMap& attacks);
+        template <int Color>
+        void mobilityUtility(attackMap& attacks, int& midgame, int& endgame);
+        template <int Color>
+        int threatUtility(attackMap& attacks);
+        template <int Color>
+        int kingSafety(pawnEntry& pawns, myPiece* king);
+        pawnEntry& pawnStructure();
+        void evaluatePawns(pawnEntry& pawns);
+        int pawnShelter(pawnEntry& pawns, int color, int zone);
+        int neuralUtility();
 
         //Functions related to generating possible actions that can be taken
-        //so the actions function can consider different piece behavior
-        vector<action> generateKingMoves(myPiece* king);
-        vector<action> generateQueenMoves(myPiece* queen);
-        vector<action> generateKnightMoves(myPiece* knight);
-        vector<action> generateRookMoves(myPiece* rook);
-        vector<action> generateBishopMoves(myPiece* bishop);
-        vector<action> generatePawnMoves(myPiece* pawn);
+        //so the actions function can consider different piece behavior.
+        //Each appends the moves it finds to actions.
+        void generateKingMoves(myPiece* king, vector<action>& actions);
+        void generateQueenMoves(myPiece* queen, vector<action>& actions);
+        void generateKnightMoves(myPiece* knight, vector<action>& actions);
+        void generateRookMoves(myPiece* rook, vector<action>& actions);
+        void generateBishopMoves(myPiece* bishop, vector<action>& actions);
+        template <int Color>
+        void generatePawnMoves(myPiece* pawn, vector<action>& actions);
 
         //Various helper functions to determine information about the board state
         int occupied(const int rank, const int file, const myPlayer* player);
@@ -145,18 +245,37 @@ class state
         bool validForCheck(bool isOwnPiece, action a);
         bool isCheck(const myPlayer* player);
         bool isDraw();
-        int isOpenFile(string targetFile, myPlayer* player);
-        int pawnProgression(string targetFile, myPlayer* player);
-        int pinnedSquares(const myPlayer* player);
+        int isOpenFile(pawnEntry& pawns, int file, int color);
+        int pawnProgression(pawnEntry& pawns, int file, int color);
         void removeTakenPiece(const int rank, const string file);
         string getType(const int rank, const string file);
 
+        //Functions related to the Zobrist key of the state
+        static bool initializeZobrist();
+        void calculateHash();
+        void calculateCastlingRights();
+        int enPassantFile();
+        int pieceIndex(const string& type);
+        int squareIndex(const int rank, const string& file);
+
+        //Replaces the evaluation weights. Material already summed in existing states
+        //keeps the old piece values, so states are rebuilt after calling this.
+        static void setWeights(const evalWeights& w);
+        static int midgameMargin();
+        static int endgameMargin();
+
+        //Functions related to the material and piece-square accumulators and the pawn key
+        void calculateScores();
+        void addPieceScores(int color, int type, int square, int sign);
+        void refreshAccumulator(int perspective);
+
         //Functions to convert the string for the file portion of a chess coordinate
         //to a more clear integer format
         int fileToInt(string file);
         string intToFile(int file);
 
         void operator=(const state& s);
+        void copyPieces(const myPlayer* from, myPlayer* to);
 
         friend ostream& operator<<(ostream& os, const state& s);
 };
@@ -178,15 +297,28 @@ class game
 		//It is considered a loss if a player runs out of time.
 		double whiteTimeRemaining = GAME_TIME_ALLOWED;
 		double blackTimeRemaining = GAME_TIME_ALLOWED;
+		//Time control. Each player gains increment seconds after every move and,
+		//when movesPerControl is not 0, gains timeAllowed seconds again after
+		//every movesPerControl moves.
+		double timeAllowed = GAME_TIME_ALLOWED;
+		double increment = 0;
+		int movesPerControl = 0;
 		//A turn counter
 		int currentTurn = 0;
 
 		//Sets up the current_state to have pieces in the correct starting positions
 		void initializeBoard();
+		//Sets up the current_state from a position in Forsyth-Edwards Notation. Returns
+		//false if the FEN cannot be read or describes a position that cannot occur.
+		bool loadFEN(const string& fen);
 		//Validates moves returned by the players
 		bool valid_move(action move);
 		//Updates the game's characteristics after a valid action is selected
 		void update(action move);
+		//Functions related to the time control
+		void setTimeControl(double seconds, double inc, int moves);
+		int movesToGo(int turnsAhead = 0);
+		void addTimeControlBonus(int rankDirection);
 		//Evaluates an exit code if the game comes to an end or flags that the game
 		//continues
 		int is_game_over();
@@ -30,17 +30,251 @@
 
 #include <iostream>
 #include <time.h>
+#include <string>
 #include "game.h"
 #include "ai.h"
+#include "bench.h"
+#include "bitbase.h"
+#include "tuner.h"
+#include "spsa.h"
 
 using namespace std;
 
 //The main function selects if humans or AI's control the pieces then runs a single game of chess
-int main()
+//Command line options:
+//  --threads N        number of search threads used by each AI player (default 1)
+//  --parallel MODE    parallel search used with more than one thread, lazy (default) or ybwc
+//  --ponder           AI players search on their opponent's time
+//  --time SECONDS     time on each player's clock (default 900)
+//  --inc SECONDS      increment added after each move
+//  --movestogo N      moves per time control, the clock is refilled after every N moves
+//  --movetime SECONDS fixed time AI players spend on each move
+//  --depth N          fixed search depth for AI players
+//  --nodes N          fixed number of nodes searched by AI players
+//  --stats            print search statistics as a line of JSON after every depth
+//  --hash MB          size of each AI player's transposition table
+//  --multipv K        AI players find and print their K best lines at every depth
+//  --bitbases DIR     directory of the endgame bitbases AI players use (default bitbases)
+//  --book FILE        Polyglot opening book AI players play from
+//  --bookkeys FILE    file holding the 781 Polyglot random numbers (default polyglot_keys.txt)
+//  --bookbest         play the book's heaviest move instead of a weighted random one
+//  --nnue FILE        network evaluated by strategy 2 players (default nnue.bin)
+//  --param NAME=VALUE set a search parameter of AI players, see searchParams.h
+//  --nohistoryfiles   AI players keep their history tables in memory only
+//  bench              search the bench positions instead of playing a game, using
+//                     --depth (default 2), --hash (default 16), --threads, --parallel, and
+//                     --strategy S to select the heuristic (default 0, 2 for the network)
+//  bitbases [KRKP..]  build the bitbases of the listed endings, or of every ending of
+//                     three and four pieces, in the --bitbases directory
+//  packpositions TEXT FILE
+//                     pack the labelled FENs of TEXT into FILE for the tune command
+//  tune FILE          tune the evaluation weights on the packed positions of FILE for
+//                     --iterations N (default 50) on every core or --threads, writing
+//                     them to --weights HEADER (default tunedWeights.h)
+//  spsa               tune the search parameters, starting from --param, for --iterations
+//                     of --games N (default 16) games between two players on every core
+//                     or --threads, each with --time (default 10) and --inc (default 0.1)
+int main(int argc, char* argv[])
 {
 	game test_game;
 
+	int numThreads = 1;
+	int parallelMode = LAZY_SMP;
+	bool ponder = false;
+	bool printStats = false;
+	double timeAllowed = test_game.GAME_TIME_ALLOWED;
+	double increment = 0;
+	int movesPerControl = 0;
+	searchLimits limits;
+	int hashMB = 0;
+	bool bench = false;
+	int benchStrategy = 0;
+	int multiPV = 1;
+	string bitbaseDir = "bitbases";
+	bool buildBitbases = false;
+	vector<string> bitbaseEndings;
+	string bookFile = "";
+	string bookKeys = "polyglot_keys.txt";
+	bool bookBest = false;
+	string nnueFile = "nnue.bin";
+	bool threadsGiven = false;
+	string tuneFile = "";
+	string packFile = "";
+	string weightsHeader = "tunedWeights.h";
+	int tuneIterations = 50;
+	searchParams params;
+	bool persistHistory = true;
+	bool spsa = false;
+	int spsaGames = 16;
+	bool clockGiven = false;
+
+	//Read the command line options
+	for(int i = 1; i < argc; i++)
+	{
+		string option = argv[i];
+		if(option == "--threads" && i + 1 < argc)
+		{
+			numThreads = atoi(argv[++i]);
+			if(numThreads < 1)
+				numThreads = 1;
+			threadsGiven = true;
+		}
+		else if(option == "--ponder")
+		{
+			ponder = true;
+		}
+		else if(option == "--stats")
+		{
+			printStats = true;
+		}
+		else if(option == "--time" && i + 1 < argc)
+		{
+			timeAllowed = atof(argv[++i]);
+			clockGiven = true;
+		}
+		else if(option == "--inc" && i + 1 < argc)
+		{
+			increment = atof(argv[++i]);
+			clockGiven = true;
+		}
+		else if(option == "--movestogo" && i + 1 < argc)
+		{
+			movesPerControl = atoi(argv[++i]);
+		}
+		else if(option == "--movetime" && i + 1 < argc)
+		{
+			limits.moveTime = atof(argv[++i]);
+		}
+		else if(option == "--depth" && i + 1 < argc)
+		{
+			limits.depth = atoi(argv[++i]);
+		}
+		else if(option == "--nodes" && i + 1 < argc)
+		{
+			limits.nodes = atoll(argv[++i]);
+		}
+		else if(option == "--hash" && i + 1 < argc)
+		{
+			hashMB = atoi(argv[++i]);
+		}
+		else if(option == "--multipv" && i + 1 < argc)
+		{
+			multiPV = atoi(argv[++i]);
+		}
+		else if(option == "--strategy" && i + 1 < argc)
+		{
+			benchStrategy = atoi(argv[++i]);
+		}
+		else if(option == "bench")
+		{
+			bench = true;
+		}
+		else if(option == "--bitbases" && i + 1 < argc)
+		{
+			bitbaseDir = argv[++i];
+		}
+		else if(option == "--book" && i + 1 < argc)
+		{
+			bookFile = argv[++i];
+		}
+		else if(option == "--bookkeys" && i + 1 < argc)
+		{
+			bookKeys = argv[++i];
+		}
+		else if(option == "--bookbest")
+		{
+			bookBest = true;
+		}
+		else if(option == "--nnue" && i + 1 < argc)
+		{
+			nnueFile = argv[++i];
+		}
+		else if(option == "tune" && i + 1 < argc)
+		{
+			tuneFile = argv[++i];
+		}
+		else if(option == "packpositions" && i + 2 < argc)
+		{
+			packFile = argv[++i];
+			tuneFile = argv[++i];
+		}
+		else if(option == "--iterations" && i + 1 < argc)
+		{
+			tuneIterations = atoi(argv[++i]);
+		}
+		else if(option == "--weights" && i + 1 < argc)
+		{
+			weightsHeader = argv[++i];
+		}
+		else if(option == "--param" && i + 1 < argc)
+		{
+			if(!params.set(argv[++i]))
+				cerr << "Ignoring the unknown or out of range search parameter " << argv[i] << endl;
+		}
+		else if(option == "--nohistoryfiles")
+		{
+			persistHistory = false;
+		}
+		else if(option == "spsa")
+		{
+			spsa = true;
+		}
+		else if(option == "--games" && i + 1 < argc)
+		{
+			spsaGames = atoi(argv[++i]);
+			if(spsaGames < 2)
+				spsaGames = 2;
+		}
+		else if(option == "bitbases")
+		{
+			buildBitbases = true;
+		}
+		else if(buildBitbases && (option[0] == 'K' || option[0] == 'k'))
+		{
+			bitbaseEndings.push_back(option);
+		}
+		else if(option == "--parallel" && i + 1 < argc)
+		{
+			string mode = argv[++i];
+			if(mode == "ybwc")
+				parallelMode = YBWC;
+			else
+				parallelMode = LAZY_SMP;
+		}
+	}
+
+	if(bench)
+	{
+		if(benchStrategy == 2 && !nnue::network().load(nnueFile))
+			cerr << "Strategy 2 uses the advanced heuristic without a network" << endl;
+		const int BENCH_DEPTH = 2;
+		const int BENCH_HASH_MB = 16;
+		return runBench(limits.depth > 0 ? limits.depth : BENCH_DEPTH, hashMB > 0 ? hashMB : BENCH_HASH_MB,
+		                numThreads, parallelMode, benchStrategy);
+	}
+
+	if(!packFile.empty())
+		return packPositions(packFile, tuneFile);
+
+	if(!tuneFile.empty())
+		return runTuner(tuneFile, weightsHeader, tuneIterations, threadsGiven ? numThreads : 0);
+
+	if(spsa)
+	{
+		const double SPSA_TIME = 10;
+		const double SPSA_INCREMENT = 0.1;
+		return runSPSA(params, tuneIterations, spsaGames, threadsGiven ? numThreads : 0,
+		               clockGiven ? timeAllowed : SPSA_TIME, clockGiven ? increment : SPSA_INCREMENT);
+	}
+
+	if(buildBitbases)
+	{
+		bitbase tables;
+		return tables.generate(bitbaseDir, bitbaseEndings) ? 0 : 1;
+	}
+
 	test_game.initializeBoard();
+	test_game.setTimeControl(timeAllowed, increment, movesPerControl);
 
 	string whitePlayerType = "none";
 	string blackPlayerType = "none";
@@ -48,7 +282,7 @@ int main()
 	vector<humanPlayer*> humans;
 	vector<ai*> ais;
 
-	time_t startOfTurn;
+	gameClock::time_point startOfTurn;
 	double time_passed;
 
 	action next_move;
@@ -58,7 +292,8 @@ int main()
 	{
 		int choice;
 		cout << "Select Number of Player Type for White Pieces" << endl;
-		cout << "1) Human Player\n2) AI Player (Advanced Heuristic)\n3) AI Player (Simple Heuristic)" << endl;
+		cout << "1) Human Player\n2) AI Player (Advanced Heuristic)\n3) AI Player (Simple Heuristic)\n"
+		     << "4) AI Player (Neural Network)" << endl;
 		cin >> choice;
 		switch (choice)
 		{
@@ -71,6 +306,9 @@ int main()
 			case 3:
 				whitePlayerType = "ai 1";
 				break;
+			case 4:
+				whitePlayerType = "ai 2";
+				break;
 			default:
 				cout << "Invalid selection. Enter the number of one of the provided choices." << endl;
 		}
@@ -81,7 +319,8 @@ int main()
 	{
 		int choice;
 		cout << "Select Number of Player Type for Black Pieces" << endl;
-		cout << "1) Human Player\n2) AI Player (Advanced Heuristic)\n3) AI Player (Simple Heuristic)" << endl;
+		cout << "1) Human Player\n2) AI Player (Advanced Heuristic)\n3) AI Player (Simple Heuristic)\n"
+		     << "4) AI Player (Neural Network)" << endl;
 		cin >> choice;
 		switch (choice)
 		{
@@ -94,6 +333,9 @@ int main()
 			case 3:
 				blackPlayerType = "ai 1";
 				break;
+			case 4:
+				blackPlayerType = "ai 2";
+				break;
 			default:
 				cout << "Invalid selection. Enter the number of one of the provided choices." << endl;
 		}
@@ -111,7 +353,7 @@ int main()
 	{
 		//Initialize an AI player with strategy 0 and htFile 0
 		ai* tmp;
-		tmp = new ai(0,'0');
+		tmp = new ai(0,'0',numThreads);
 		tmp->target_game = &test_game;
 		ais.push_back(tmp);
 	}
@@ -119,7 +361,15 @@ int main()
 	{
 		//Initialize an AI player with strategy 1 and htFile 0
 		ai* tmp;
-		tmp = new ai(1,'0');
+		tmp = new ai(1,'0',numThreads);
+		tmp->target_game = &test_game;
+		ais.push_back(tmp);
+	}
+	else if(whitePlayerType == "ai 2")
+	{
+		//Initialize an AI player with strategy 2 and htFile 0
+		ai* tmp;
+		tmp = new ai(2,'0',numThreads);
 		tmp->target_game = &test_game;
 		ais.push_back(tmp);
 	}
@@ -136,7 +386,7 @@ int main()
 	{
 		//Initialize AI player with strategy 0 and htFile 1
 		ai* tmp;
-		tmp = new ai(0,'1');
+		tmp = new ai(0,'1',numThreads);
 		tmp->target_game = &test_game;
 		ais.push_back(tmp);
 	}
@@ -144,15 +394,41 @@ int main()
 	{
 		//Initialize AI player with strategy 1 and htFile 1
 		ai* tmp;
-		tmp = new ai(1,'1');
+		tmp = new ai(1,'1',numThreads);
+		tmp->target_game = &test_game;
+		ais.push_back(tmp);
+	}
+	else if(blackPlayerType == "ai 2")
+	{
+		//Initialize AI player with strategy 2 and htFile 1
+		ai* tmp;
+		tmp = new ai(2,'1',numThreads);
 		tmp->target_game = &test_game;
 		ais.push_back(tmp);
 	}
 
+	//The network is shared by both players and only read if one of them uses it
+	if((whitePlayerType == "ai 2" || blackPlayerType == "ai 2") && !nnue::network().load(nnueFile))
+		cerr << "Strategy 2 uses the advanced heuristic without a network" << endl;
+
 	//Make sure AI's have initialized history tables
 	for(unsigned int i = 0; i < ais.size(); i++)
 	{
-		ais[i]->initializeHistoryTable();
+		ais[i]->parallelMode = parallelMode;
+		ais[i]->ponderEnabled = ponder;
+		ais[i]->limits = limits;
+		ais[i]->printStats = printStats;
+		ais[i]->multiPV = multiPV;
+		if(hashMB > 0)
+			ais[i]->tt->resize(hashMB);
+		ais[i]->bitbases->load(bitbaseDir);
+		ais[i]->bookRandom = !bookBest;
+		if(bookFile != "")
+			ais[i]->book->load(bookFile, bookKeys);
+		ais[i]->params = params;
+		ais[i]->persistHistory = persistHistory;
+		if(persistHistory)
+			ais[i]->initializeHistoryTable();
 	}
 
 	//Main game loop continuing until a terminal state is encountered
@@ -166,16 +442,20 @@ int main()
 				//Display game
 				test_game.renderGame();
 				//Begin move timer
-				time(&startOfTurn);
+				startOfTurn = gameClock::now();
 				//Request move choice from human white player
 				next_move = humans.front()->runTurn();
 				//Calculate used time for turn
-				time_passed = difftime(time(NULL),startOfTurn);
+				time_passed = secondsSince(startOfTurn);
 				test_game.whiteTimeRemaining -= time_passed;
-			}while(!test_game.valid_move(next_move));
+			}while(test_game.whiteTimeRemaining > 0 && !test_game.valid_move(next_move));
+			//A player whose clock ran out has lost, even if the increment would refill it
+			if(test_game.whiteTimeRemaining <= 0)
+				break;
 			//Store move choice and update board state
 			test_game.move_log.push_back(next_move);
 			test_game.update(next_move);
+			test_game.addTimeControlBonus(1);
 		}
 		else
 		{
@@ -184,16 +464,22 @@ int main()
 				//Display game
 				test_game.renderGame();
 				//Begin move timer
-				time(&startOfTurn);
+				startOfTurn = gameClock::now();
 				//Request move choice from AI white player
 				next_move = ais.front()->runTurn();
 				//Calculate used time for turn
-				time_passed = difftime(time(NULL),startOfTurn);
+				time_passed = secondsSince(startOfTurn);
 				test_game.whiteTimeRemaining -= time_passed;
-			}while(!test_game.valid_move(next_move));
+			}while(test_game.whiteTimeRemaining > 0 && !test_game.valid_move(next_move));
+			//A player whose clock ran out has lost, even if the increment would refill it
+			if(test_game.whiteTimeRemaining <= 0)
+				break;
 			//Store move choice and update board state
 			test_game.move_log.push_back(next_move);
 			test_game.update(next_move);
+			test_game.addTimeControlBonus(1);
+			//Think about black's expected reply during black's turn
+			ais.front()->startPondering();
 		}
 		//Check to see if white's move created a terminal state
 		if(test_game.is_game_over())
@@ -206,16 +492,20 @@ int main()
 				//Display game
 				test_game.renderGame();
 				//Begin move timer
-				time(&startOfTurn);
+				startOfTurn = gameClock::now();
 				//Request move choice from human black player
 				next_move = humans.back()->runTurn();
 				//Calculate used time for turn
-				time_passed = difftime(time(NULL),startOfTurn);
+				time_passed = secondsSince(startOfTurn);
 				test_game.blackTimeRemaining -= time_passed;
-			}while(!test_game.valid_move(next_move));
+			}while(test_game.blackTimeRemaining > 0 && !test_game.valid_move(next_move));
+			//A player whose clock ran out has lost, even if the increment would refill it
+			if(test_game.blackTimeRemaining <= 0)
+				break;
 			//Store move choice and update board state
 			test_game.move_log.push_back(next_move);
 			test_game.update(next_move);
+			test_game.addTimeControlBonus(-1);
 		}
 		else
 		{
@@ -224,18 +514,29 @@ int main()
 				//Display game
 				test_game.renderGame();
 				//Begin move timer
-				time(&startOfTurn);
+				startOfTurn = gameClock::now();
 				//Request move choice from AI black player
 				next_move = ais.back()->runTurn();
 				//Calculate used time for turn
-				time_passed = difftime(time(NULL),startOfTurn);
+				time_passed = secondsSince(startOfTurn);
 				test_game.blackTimeRemaining -= time_passed;
-			}while(!test_game.valid_move(next_move));
+			}while(test_game.blackTimeRemaining > 0 && !test_game.valid_move(next_move));
+			//A player whose clock ran out has lost, even if the increment would refill it
+			if(test_game.blackTimeRemaining <= 0)
+				break;
 			//Store move choice and update board state
 			test_game.move_log.push_back(next_move);
 			test_game.update(next_move);
+			test_game.addTimeControlBonus(-1);
+			//Think about white's expected reply during white's turn
+			ais.back()->startPondering();
 		}
 	}
+	//End any search still running on the opponent's time
+	for(unsigned int i = 0; i < ais.size(); i++)
+	{
+		ais[i]->stopPondering();
+	}
 	//Upon end of game, display final board and print what caused the end of game
 	test_game.renderGame();
 	test_game.printVictoryResults();
@@ -0,0 +1,227 @@
+/*
+ * nnue.cpp
+ * This file contains the function implementations for the nnue class. The kernels
+ * use AVX2 or SSE4.1 when the compiler targets them and plain loops otherwise.
+ */
+
+#include "nnue.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+nnue& nnue::network()
+{
+    static nnue shared;
+    return shared;
+}
+
+bool nnue::isLoaded()
+{
+    return loaded;
+}
+
+//Reads count values of type T from in into values. The file is little-endian
+//like every machine the kernels target, so the bytes are used as they are.
+template <typename T>
+static bool readValues(ifstream& in, vector<T>& values, size_t count)
+{
+    values.resize(count);
+    in.read((char*)values.data(), count * sizeof(T));
+    return (bool)in;
+}
+
+bool nnue::load(const string& file)
+{
+    ifstream in(file.c_str(), ios::binary);
+    if(!in)
+    {
+        cerr << "Could not open the network " << file << endl;
+        return false;
+    }
+
+    char magic[4];
+    unsigned int header[3];
+    in.read(magic, 4);
+    in.read((char*)header, sizeof(header));
+    if(!in || memcmp(magic, "CNUE", 4) != 0 || header[0] != VERSION ||
+       header[1] != (unsigned int)HALF_DIMENSIONS || header[2] != (unsigned int)HIDDEN)
+    {
+        cerr << "The network " << file << " is not a version " << VERSION << " network of "
+             << HALF_DIMENSIONS << "x2-" << HIDDEN << "-" << HIDDEN << "-1" << endl;
+        return false;
+    }
+
+    vector<int> output(1);
+    bool complete = readValues(in, featureBiases, HALF_DIMENSIONS) &&
+                    readValues(in, featureWeights, (size_t)INPUTS * HALF_DIMENSIONS) &&
+                    readValues(in, hidden1Biases, HIDDEN) &&
+                    readValues(in, hidden1Weights, HIDDEN * 2 * HALF_DIMENSIONS) &&
+                    readValues(in, hidden2Biases, HIDDEN) &&
+                    readValues(in, hidden2Weights, HIDDEN * HIDDEN) &&
+                    readValues(in, output, 1) &&
+                    readValues(in, outputWeights, HIDDEN);
+    if(!complete || in.peek() != EOF)
+    {
+        cerr << "The network " << file << " has the wrong size" << endl;
+        loaded = false;
+        return false;
+    }
+    outputBias = output[0];
+    loaded = true;
+    return true;
+}
+
+int nnue::featureIndex(int perspective, int kingSquare, int color, int type, int square)
+{
+    if(perspective == 1)
+    {
+        kingSquare ^= 56;
+        square ^= 56;
+    }
+    int kind = type * 2 + ((color == perspective) ? 0 : 1);
+    return kingSquare * PIECE_FEATURES + kind * 64 + square;
+}
+
+void nnue::resetAccumulator(short* accumulator)
+{
+    memcpy(accumulator, featureBiases.data(), HALF_DIMENSIONS * sizeof(short));
+}
+
+void nnue::addFeature(short* accumulator, int feature)
+{
+    const short* row = &featureWeights[(size_t)feature * HALF_DIMENSIONS];
+#if defined(__AVX2__)
+    for(int i = 0; i < HALF_DIMENSIONS; i += 16)
+    {
+        __m256i sum = _mm256_loadu_si256((const __m256i*)(accumulator + i));
+        sum = _mm256_add_epi16(sum, _mm256_loadu_si256((const __m256i*)(row + i)));
+        _mm256_storeu_si256((__m256i*)(accumulator + i), sum);
+    }
+#elif defined(__SSE4_1__)
+    for(int i = 0; i < HALF_DIMENSIONS; i += 8)
+    {
+        __m128i sum = _mm_loadu_si128((const __m128i*)(accumulator + i));
+        sum = _mm_add_epi16(sum, _mm_loadu_si128((const __m128i*)(row + i)));
+        _mm_storeu_si128((__m128i*)(accumulator + i), sum);
+    }
+#else
+    for(int i = 0; i < HALF_DIMENSIONS; i++)
+        accumulator[i] += row[i];
+#endif
+}
+
+void nnue::subtractFeature(short* accumulator, int feature)
+{
+    const short* row = &featureWeights[(size_t)feature * HALF_DIMENSIONS];
+#if defined(__AVX2__)
+    for(int i = 0; i < HALF_DIMENSIONS; i += 16)
+    {
+        __m256i sum = _mm256_loadu_si256((const __m256i*)(accumulator + i));
+        sum = _mm256_sub_epi16(sum, _mm256_loadu_si256((const __m256i*)(row + i)));
+        _mm256_storeu_si256((__m256i*)(accumulator + i), sum);
+    }
+#elif defined(__SSE4_1__)
+    for(int i = 0; i < HALF_DIMENSIONS; i += 8)
+    {
+        __m128i sum = _mm_loadu_si128((const __m128i*)(accumulator + i));
+        sum = _mm_sub_epi16(sum, _mm_loadu_si128((const __m128i*)(row + i)));
+        _mm_storeu_si128((__m128i*)(accumulator + i), sum);
+    }
+#else
+    for(int i = 0; i < HALF_DIMENSIONS; i++)
+        accumulator[i] -= row[i];
+#endif
+}
+
+//Clips the first layer sums of one side to 0-127 and packs them into bytes
+static void clipAccumulator(const short* accumulator, unsigned char* output)
+{
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    for(int i = 0; i < nnue::HALF_DIMENSIONS; i += 32)
+    {
+        __m256i low = _mm256_loadu_si256((const __m256i*)(accumulator + i));
+        __m256i high = _mm256_loadu_si256((const __m256i*)(accumulator + i + 16));
+        //packing works within 128 bit lanes, so the quarters are put back in order
+        __m256i packed = _mm256_max_epi8(_mm256_packs_epi16(low, high), zero);
+        _mm256_storeu_si256((__m256i*)(output + i), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+#elif defined(__SSE4_1__)
+    const __m128i zero = _mm_setzero_si128();
+    for(int i = 0; i < nnue::HALF_DIMENSIONS; i += 16)
+    {
+        __m128i low = _mm_loadu_si128((const __m128i*)(accumulator + i));
+        __m128i high = _mm_loadu_si128((const __m128i*)(accumulator + i + 8));
+        _mm_storeu_si128((__m128i*)(output + i), _mm_max_epi8(_mm_packs_epi16(low, high), zero));
+    }
+#else
+    for(int i = 0; i < nnue::HALF_DIMENSIONS; i++)
+        output[i] = (unsigned char)min(127, max(0, (int)accumulator[i]));
+#endif
+}
+
+//Computes a hidden layer of HIDDEN outputs from inputSize bytes, a multiple of 32.
+//Each output is its weighted sum shifted down by WEIGHT_SHIFT and clipped to 0-127.
+void nnue::affine(const unsigned char* input, int inputSize, const signed char* weights,
+                  const int* biases, unsigned char* output)
+{
+    for(int j = 0; j < HIDDEN; j++)
+    {
+        const signed char* row = weights + j * inputSize;
+        int sum = biases[j];
+#if defined(__AVX2__)
+        const __m256i ones = _mm256_set1_epi16(1);
+        __m256i sums = _mm256_setzero_si256();
+        for(int i = 0; i < inputSize; i += 32)
+        {
+            __m256i products = _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*)(input + i)),
+                                                    _mm256_loadu_si256((const __m256i*)(row + i)));
+            sums = _mm256_add_epi32(sums, _mm256_madd_epi16(products, ones));
+        }
+        __m128i total = _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+        total = _mm_hadd_epi32(total, total);
+        total = _mm_hadd_epi32(total, total);
+        sum += _mm_cvtsi128_si32(total);
+#elif defined(__SSE4_1__)
+        const __m128i ones = _mm_set1_epi16(1);
+        __m128i sums = _mm_setzero_si128();
+        for(int i = 0; i < inputSize; i += 16)
+        {
+            __m128i products = _mm_maddubs_epi16(_mm_loadu_si128((const __m128i*)(input + i)),
+                                                 _mm_loadu_si128((const __m128i*)(row + i)));
+            sums = _mm_add_epi32(sums, _mm_madd_epi16(products, ones));
+        }
+        sums = _mm_hadd_epi32(sums, sums);
+        sums = _mm_hadd_epi32(sums, sums);
+        sum += _mm_cvtsi128_si32(sums);
+#else
+        for(int i = 0; i < inputSize; i++)
+            sum += input[i] * row[i];
+#endif
+        output[j] = (unsigned char)min(127, max(0, sum >> WEIGHT_SHIFT));
+    }
+}
+
+int nnue::evaluate(const short* us, const short* them)
+{
+    unsigned char transformed[2 * HALF_DIMENSIONS];
+    unsigned char hidden1[HIDDEN];
+    unsigned char hidden2[HIDDEN];
+
+    clipAccumulator(us, transformed);
+    clipAccumulator(them, transformed + HALF_DIMENSIONS);
+    affine(transformed, 2 * HALF_DIMENSIONS, hidden1Weights.data(), hidden1Biases.data(), hidden1);
+    affine(hidden1, HIDDEN, hidden2Weights.data(), hidden2Biases.data(), hidden2);
+
+    int sum = outputBias;
+    for(int i = 0; i < HIDDEN; i++)
+        sum += hidden2[i] * outputWeights[i];
+    return sum / OUTPUT_SCALE;
+}
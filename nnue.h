@@ -0,0 +1,82 @@
+/*
+ * nnue.h
+ * This file contains the header information for the nnue class, the efficiently
+ * updatable neural network used by evaluation strategy 2.
+ */
+
+#ifndef NNUE_H_
+#define NNUE_H_
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//The nnue class holds the weights of a network with HalfKP inputs. Every input is
+//a non-king piece on a square seen from one king, so each side's half of the first
+//layer only changes by a few rows when a piece moves and is kept up to date in the
+//states of the search instead of being recomputed. The remaining layers are small
+//and run on the quantized first layer output with integer SIMD kernels.
+//
+//Network file layout, all values little-endian:
+//  "CNUE", uint32 version, uint32 HALF_DIMENSIONS, uint32 HIDDEN
+//  int16 first layer biases[HALF_DIMENSIONS], weights[INPUTS][HALF_DIMENSIONS]
+//  int32 hidden layer 1 biases[HIDDEN], int8 weights[HIDDEN][2 * HALF_DIMENSIONS]
+//  int32 hidden layer 2 biases[HIDDEN], int8 weights[HIDDEN][HIDDEN]
+//  int32 output bias, int8 output weights[HIDDEN]
+//The output divided by OUTPUT_SCALE is the utility for the player to move in the
+//units of the piece values, where a pawn is 1000.
+class nnue
+{
+    public:
+        static const unsigned int VERSION = 1;
+        //Ten kinds of non-king pieces on 64 squares, for each of 64 king squares
+        static const int PIECE_FEATURES = 640;
+        static const int INPUTS = 64 * PIECE_FEATURES;
+        static const int HALF_DIMENSIONS = 256;
+        static const int HIDDEN = 32;
+        //Hidden layer sums are shifted down by WEIGHT_SHIFT before clipping to 0-127
+        static const int WEIGHT_SHIFT = 6;
+        static const int OUTPUT_SCALE = 16;
+
+        //The network shared by every state and search thread
+        static nnue& network();
+
+        nnue() {}
+        nnue(const nnue&) = delete;
+        nnue& operator=(const nnue&) = delete;
+
+        //Reads a network file. Returns false and prints the reason if it cannot be used.
+        bool load(const string& file);
+        bool isLoaded();
+
+        //Returns the input index of a piece of color and type (pawn 0 to queen 4) on
+        //square, seen by perspective whose king stands on kingSquare. Black's view is
+        //mirrored so both sides see their own pieces moving up the board.
+        static int featureIndex(int perspective, int kingSquare, int color, int type, int square);
+
+        //Sets accumulator to the first layer biases
+        void resetAccumulator(short* accumulator);
+        //Adds or subtracts the first layer weights of a feature
+        void addFeature(short* accumulator, int feature);
+        void subtractFeature(short* accumulator, int feature);
+        //Returns the output for the player to move from the accumulators of the player
+        //to move and of the opponent
+        int evaluate(const short* us, const short* them);
+
+    private:
+        bool loaded = false;
+        vector<short> featureBiases;
+        vector<short> featureWeights;
+        vector<int> hidden1Biases;
+        vector<signed char> hidden1Weights;
+        vector<int> hidden2Biases;
+        vector<signed char> hidden2Weights;
+        int outputBias = 0;
+        vector<signed char> outputWeights;
+
+        void affine(const unsigned char* input, int inputSize, const signed char* weights,
+                    const int* biases, unsigned char* output);
+};
+
+#endif /* NNUE_H_ */
@@ -0,0 +1,252 @@
+/*
+ * openingBook.cpp
+ * This file contains the function implementations for the openingBook class.
+ */
+
+#include "openingBook.h"
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+//Offsets of the castling, en passant and side to move numbers among the randoms
+static const int RANDOM_CASTLE = 768;
+static const int RANDOM_EN_PASSANT = 772;
+static const int RANDOM_TURN = 780;
+static const int ENTRY_SIZE = 16;
+
+openingBook::~openingBook()
+{
+    if(mapping != NULL)
+        munmap(mapping, mappingSize);
+}
+
+bool openingBook::isLoaded()
+{
+    return entries != NULL;
+}
+
+bool openingBook::load(const string& bookFile, const string& keyFile)
+{
+    if(!loadKeys(keyFile))
+        return false;
+
+    int fd = open(bookFile.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        cerr << "Could not open the opening book " << bookFile << endl;
+        return false;
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size < ENTRY_SIZE)
+    {
+        close(fd);
+        cerr << "The opening book " << bookFile << " is empty" << endl;
+        return false;
+    }
+    void* newMapping = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(newMapping == MAP_FAILED)
+    {
+        cerr << "Could not map the opening book " << bookFile << endl;
+        return false;
+    }
+
+    if(mapping != NULL)
+        munmap(mapping, mappingSize);
+    mapping = newMapping;
+    mappingSize = info.st_size;
+    entries = (const unsigned char*)mapping;
+    numEntries = info.st_size / ENTRY_SIZE;
+    return true;
+}
+
+//Reads every 64 bit hex literal of the key file in order. The numbers are only
+//accepted if they give the starting position its published key.
+bool openingBook::loadKeys(const string& keyFile)
+{
+    ifstream in(keyFile.c_str());
+    if(!in)
+    {
+        cerr << "Could not open the Polyglot key file " << keyFile << endl;
+        return false;
+    }
+    stringstream contents;
+    contents << in.rdbuf();
+    string text = contents.str();
+
+    randoms.clear();
+    size_t pos = 0;
+    while((pos = text.find("0x", pos)) != string::npos && (int)randoms.size() < NUM_RANDOMS)
+    {
+        pos += 2;
+        size_t end = pos;
+        while(end < text.size() && isxdigit(text[end]))
+            end++;
+        if(end - pos == 16)
+            randoms.push_back(strtoull(text.substr(pos, 16).c_str(), NULL, 16));
+        pos = end;
+    }
+
+    game start;
+    start.initializeBoard();
+    if((int)randoms.size() != NUM_RANDOMS || polyglotKey(start.current_state) != START_POSITION_KEY)
+    {
+        cerr << "The Polyglot key file " << keyFile << " does not hold the " << NUM_RANDOMS
+             << " Polyglot random numbers" << endl;
+        randoms.clear();
+        return false;
+    }
+    return true;
+}
+
+//Pieces are numbered black pawn, white pawn, black knight and so on up to white king.
+//The en passant file only counts if a pawn of the player to move can capture on it.
+unsigned long long openingBook::polyglotKey(state& s)
+{
+    unsigned long long key = 0;
+    for(unsigned int i = 0; i < s.players.size(); i++)
+    {
+        int white = (s.players[i]->rankDirection == 1) ? 1 : 0;
+        for(unsigned int j = 0; j < s.players[i]->pieces.size(); j++)
+        {
+            myPiece* piece = s.players[i]->pieces[j];
+            int kind = 2 * s.pieceIndex(piece->type) + white;
+            key ^= randoms[64 * kind + s.squareIndex(piece->rank, piece->file)];
+        }
+    }
+
+    for(int i = 0; i < 4; i++)
+    {
+        if(s.castlingRights & (1 << i))
+            key ^= randoms[RANDOM_CASTLE + i];
+    }
+
+    int file = s.enPassantFile();
+    if(file != 0)
+    {
+        int captureRank = (s.currentPlayer->rankDirection == 1) ? 5 : 4;
+        for(unsigned int i = 0; i < s.currentPlayer->pieces.size(); i++)
+        {
+            myPiece* piece = s.currentPlayer->pieces[i];
+            if(piece->type == "Pawn" && piece->rank == captureRank && abs(s.fileToInt(piece->file) - file) == 1)
+            {
+                key ^= randoms[RANDOM_EN_PASSANT + file - 1];
+                break;
+            }
+        }
+    }
+
+    if(s.currentPlayer->rankDirection == 1)
+        key ^= randoms[RANDOM_TURN];
+    return key;
+}
+
+bookEntry openingBook::entry(unsigned long long index)
+{
+    const unsigned char* bytes = entries + index * ENTRY_SIZE;
+    bookEntry result;
+    for(int i = 0; i < 8; i++)
+        result.key = (result.key << 8) | bytes[i];
+    result.move = (bytes[8] << 8) | bytes[9];
+    result.weight = (bytes[10] << 8) | bytes[11];
+    return result;
+}
+
+//A Polyglot move holds the destination file and rank in bits 0-5, the starting file
+//and rank in bits 6-11 and the promotion piece in bits 12-14. Castling is written
+//as the king capturing its own rook.
+bool openingBook::matchMove(state& s, int move, vector<action>& legalMoves, action& result)
+{
+    const string PROMOTIONS[5] = {"", "Knight", "Bishop", "Rook", "Queen"};
+    string newFile = s.intToFile((move & 7) + 1);
+    int newRank = ((move >> 3) & 7) + 1;
+    string oldFile = s.intToFile(((move >> 6) & 7) + 1);
+    int oldRank = ((move >> 9) & 7) + 1;
+    string promotion = PROMOTIONS[min((move >> 12) & 7, 4)];
+
+    if(s.getType(oldRank, oldFile) == "King" && oldFile == "e" && newRank == oldRank)
+    {
+        if(newFile == "h")
+            newFile = "g";
+        else if(newFile == "a")
+            newFile = "c";
+    }
+
+    for(unsigned int i = 0; i < legalMoves.size(); i++)
+    {
+        action& a = legalMoves[i];
+        if(a.oldFile == oldFile && a.oldRank == oldRank && a.newFile == newFile && a.newRank == newRank &&
+           a.promotion == promotion)
+        {
+            result = a;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool openingBook::findMove(state& s, action& move, bool random)
+{
+    if(!isLoaded())
+        return false;
+    unsigned long long key = polyglotKey(s);
+
+    //find the first entry of the key
+    unsigned long long low = 0;
+    unsigned long long high = numEntries;
+    while(low < high)
+    {
+        unsigned long long middle = low + (high - low) / 2;
+        if(entry(middle).key < key)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    //the book's moves are checked against the legal actions since a book written
+    //for other rules may hold moves, such as under promotions, this game lacks
+    vector<action> legalMoves = s.actions();
+    vector<action> candidates;
+    vector<int> weights;
+    int totalWeight = 0;
+    for(unsigned long long i = low; i < numEntries; i++)
+    {
+        bookEntry e = entry(i);
+        if(e.key != key)
+            break;
+        action a;
+        if(e.weight > 0 && matchMove(s, e.move, legalMoves, a))
+        {
+            candidates.push_back(a);
+            weights.push_back(e.weight);
+            totalWeight += e.weight;
+        }
+    }
+    if(candidates.empty())
+        return false;
+
+    unsigned int chosen = 0;
+    if(random)
+    {
+        int pick = rand() % totalWeight;
+        while(pick >= weights[chosen])
+            pick -= weights[chosen++];
+    }
+    else
+    {
+        for(unsigned int i = 1; i < candidates.size(); i++)
+        {
+            if(weights[i] > weights[chosen])
+                chosen = i;
+        }
+    }
+    move = candidates[chosen];
+    return true;
+}
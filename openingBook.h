@@ -0,0 +1,63 @@
+/*
+ * openingBook.h
+ * This file contains the header information for the openingBook class, which
+ * plays moves from an opening book in the Polyglot format.
+ */
+
+#ifndef OPENINGBOOK_H_
+#define OPENINGBOOK_H_
+
+#include "game.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//A single move of the book for the position with the given key
+struct bookEntry
+{
+    unsigned long long key = 0;
+    int move = 0;
+    int weight = 0;
+};
+
+//The openingBook class maps a Polyglot .bin file into memory. The file is a list of
+//16 byte big-endian entries sorted by the Polyglot key of their position, so the
+//moves of a position are found by a binary search. Polyglot keys are built from
+//781 published random numbers which are read from a key file holding them as hex
+//literals, such as the array of the Polyglot book format description.
+class openingBook
+{
+    public:
+        //The Polyglot key of the starting position, used to check the key file
+        static const unsigned long long START_POSITION_KEY = 0x463B96181691FC9CULL;
+        static const int NUM_RANDOMS = 781;
+
+        openingBook() {}
+        ~openingBook();
+        openingBook(const openingBook&) = delete;
+        openingBook& operator=(const openingBook&) = delete;
+
+        //Reads the random numbers of keyFile and maps bookFile. Returns false and
+        //prints the reason if either cannot be used.
+        bool load(const string& bookFile, const string& keyFile);
+        bool isLoaded();
+        unsigned long long polyglotKey(state& s);
+        //Sets move to a book move of s and returns true if the book has one. With
+        //random set a move is drawn with a chance proportional to its weight,
+        //otherwise the move with the highest weight is played.
+        bool findMove(state& s, action& move, bool random);
+
+    private:
+        vector<unsigned long long> randoms;
+        const unsigned char* entries = NULL;
+        unsigned long long numEntries = 0;
+        void* mapping = NULL;
+        size_t mappingSize = 0;
+
+        bool loadKeys(const string& keyFile);
+        bookEntry entry(unsigned long long index);
+        bool matchMove(state& s, int move, vector<action>& legalMoves, action& result);
+};
+
+#endif /* OPENINGBOOK_H_ */
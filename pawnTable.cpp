@@ -0,0 +1,21 @@
+/*
+ * pawnTable.cpp
+ * This file contains the function implementations for the pawnTable class.
+ */
+
+#include "pawnTable.h"
+
+using namespace std;
+
+//A newer structure simply replaces the one in its slot
+pawnEntry& pawnTable::probe(unsigned long long key, bool& found)
+{
+    pawnEntry& e = entries[key & (NUM_ENTRIES - 1)];
+    found = e.used && e.key == key;
+    if(!found)
+    {
+        e.key = key;
+        e.used = true;
+    }
+    return e;
+}
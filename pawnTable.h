@@ -0,0 +1,61 @@
+/*
+ * pawnTable.h
+ * This file contains the header information for the pawnTable class, which caches
+ * the evaluation of pawn structures.
+ */
+
+#ifndef PAWNTABLE_H_
+#define PAWNTABLE_H_
+
+#include <vector>
+
+using namespace std;
+
+//Zones a king's shelter is evaluated for: the queen side files a-c, the king side
+//files f-h, and the center files d and e
+const int SHELTER_QUEEN_SIDE = 0;
+const int SHELTER_KING_SIDE = 1;
+const int SHELTER_D_FILE = 2;
+const int SHELTER_E_FILE = 3;
+
+//Everything the evaluation needs to know about one pawn structure. Arrays indexed
+//by color hold white's data at 0 and black's at 1.
+struct pawnEntry
+{
+    unsigned long long key = 0;
+    bool used = false;
+    //Bit f-1 is set for every file f holding a pawn of the color
+    int files[2] = {0, 0};
+    //The ranks of the color's least and most advanced pawns on every file counted
+    //from its own side of the board, 0 for files without pawns
+    int backRank[2][8];
+    int frontRank[2][8];
+    //Bit of the 0-63 square of every passed pawn of the color
+    unsigned long long passed[2] = {0, 0};
+    //Midgame and endgame scores of doubled, isolated and passed pawns from white's side
+    int midgame = 0;
+    int endgame = 0;
+    //Shelter issues of the color's pawns for a king in each shelter zone
+    int shelter[2][4];
+};
+
+//The pawnTable class is a small table of pawn structures indexed by the pawn-only
+//Zobrist key of a state. Pawn structures rarely change between the states of a
+//search, so nearly every evaluation finds its structure here. Each search thread
+//uses a table of its own, which needs no synchronization.
+class pawnTable
+{
+    public:
+        static const int NUM_ENTRIES = 16384;
+
+        pawnTable() : entries(NUM_ENTRIES) {}
+
+        //Returns the slot of key. found is set if the slot already holds key's structure,
+        //otherwise the caller fills the slot in.
+        pawnEntry& probe(unsigned long long key, bool& found);
+
+    private:
+        vector<pawnEntry> entries;
+};
+
+#endif /* PAWNTABLE_H_ */
@@ -0,0 +1,65 @@
+/*
+ * searchParams.cpp
+ * This file contains the function implementations for the searchParams struct.
+ */
+
+#include "searchParams.h"
+#include <cstdlib>
+#include <sstream>
+
+using namespace std;
+
+//The depths stay well below ai::MAX_PLY, which bounds the plies a search reaches
+//with its quiescent extensions
+const vector<searchParam>& searchParams::fields()
+{
+    static const vector<searchParam> FIELDS =
+    {
+        {"quiescentDepth", &searchParams::quiescentDepth, 0, 6, 0.5},
+        {"maxDepth", &searchParams::maxDepth, 4, 32, 1},
+        {"changeBarrier", &searchParams::changeBarrier, 100, 9000, 150},
+        {"percentTimeRemaining", &searchParams::percentTimeRemaining, 2, 30, 1},
+        {"openingTime", &searchParams::openingTime, 2, 30, 1},
+        {"ageBarrier", &searchParams::ageBarrier, 1, 30, 1},
+        {"maxActions", &searchParams::maxActions, 20, 3000, 25}
+    };
+    return FIELDS;
+}
+
+bool searchParams::set(const string& assignment)
+{
+    size_t equals = assignment.find('=');
+    if(equals == string::npos)
+        return false;
+    string name = assignment.substr(0, equals);
+    string text = assignment.substr(equals + 1);
+    char* end;
+    long value = strtol(text.c_str(), &end, 10);
+    if(text.empty() || *end != '\0')
+        return false;
+
+    for(unsigned int i = 0; i < fields().size(); i++)
+    {
+        const searchParam& field = fields()[i];
+        if(field.name == name)
+        {
+            if(value < field.minimum || value > field.maximum)
+                return false;
+            this->*field.member = (int)value;
+            return true;
+        }
+    }
+    return false;
+}
+
+string searchParams::toString() const
+{
+    ostringstream text;
+    for(unsigned int i = 0; i < fields().size(); i++)
+    {
+        if(i > 0)
+            text << " ";
+        text << fields()[i].name << "=" << this->*fields()[i].member;
+    }
+    return text.str();
+}
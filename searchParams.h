@@ -0,0 +1,56 @@
+/*
+ * searchParams.h
+ * This file contains the header information for the searchParams struct, the
+ * search and time management settings that can be changed at run time.
+ */
+
+#ifndef SEARCHPARAMS_H_
+#define SEARCHPARAMS_H_
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct searchParam;
+
+//Settings of an ai's search. Each ai keeps its own copy so players with different
+//settings can play each other, as the spsa command does.
+struct searchParams
+{
+    //Plies searched past the horizon while states keep changing in utility by more
+    //than changeBarrier, and the deepest depth of the iterative deepening
+    int quiescentDepth = 3;
+    int maxDepth = 20;
+    int changeBarrier = 2000;
+    //Percent of the remaining time planned for a move in sudden death, and for the
+    //first move out of the opening
+    int percentTimeRemaining = 8;
+    int openingTime = 7;
+    //History table entries are purged once they are ageBarrier turns old or the
+    //table holds maxActions of them
+    int ageBarrier = 6;
+    int maxActions = 300;
+
+    //Sets the parameter named in an assignment of the form name=value. Returns false
+    //if there is no such parameter or the value is outside its range.
+    bool set(const string& assignment);
+    //Returns the parameters as name=value assignments separated by spaces
+    string toString() const;
+
+    //Every parameter with its range
+    static const vector<searchParam>& fields();
+};
+
+//A searchParams member with the range it may take and the size of the change the
+//spsa command tries it with at the end of a tuning run
+struct searchParam
+{
+    string name;
+    int searchParams::* member;
+    int minimum;
+    int maximum;
+    double finalStep;
+};
+
+#endif /* SEARCHPARAMS_H_ */
@@ -0,0 +1,43 @@
+/*
+ * searchStack.cpp
+ * This file contains the function implementations for the searchStack class.
+ */
+
+#include "searchStack.h"
+
+using namespace std;
+
+searchStack::searchStack(int numPlies)
+{
+    plies = numPlies;
+    frames.reset(new searchFrame[plies]);
+    for(int i = 0; i < plies; i++)
+    {
+        frames[i].pv.reserve(plies);
+    }
+}
+
+searchStack::searchStack(const searchStack& other) : searchStack(other.plies)
+{
+}
+
+searchStack::searchStack(searchStack&& other) noexcept
+{
+    plies = other.plies;
+    frames = move(other.frames);
+    other.plies = 0;
+}
+
+int searchStack::size()
+{
+    return plies;
+}
+
+void searchStack::clearKillers()
+{
+    for(int i = 0; i < plies; i++)
+    {
+        frames[i].killers[0] = action();
+        frames[i].killers[1] = action();
+    }
+}
@@ -0,0 +1,53 @@
+/*
+ * searchStack.h
+ * This file contains the header information for the searchStack class, the
+ * preallocated frames used by the ai's game tree search at every ply.
+ */
+
+#ifndef SEARCHSTACK_H_
+#define SEARCHSTACK_H_
+
+#include "game.h"
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+//Everything a node of the game tree needs at one ply. The frames are allocated once
+//so the recursion of the search reuses their boards and vectors instead of copying
+//states and building new containers at every node.
+struct searchFrame
+{
+    //The state reached by the action being searched from this ply's node
+    state child;
+    //The node's actions, kept as a heap ordered by their orderValue
+    vector<action> moves;
+    //Two actions that recently caused a cutoff at this ply
+    action killers[2];
+    //The utility of the node's state, calculated once when its children need it
+    int staticEval = 0;
+    //The principal variation found from this ply's node
+    vector<action> pv;
+};
+
+//The searchStack class holds one searchFrame for every ply of a search
+class searchStack
+{
+    public:
+        searchStack(int numPlies);
+        //A copy gets its own empty frames, since a frame's state cannot be shared.
+        //Moving keeps the frames at the same address.
+        searchStack(const searchStack& other);
+        searchStack(searchStack&& other) noexcept;
+
+        searchFrame& operator[](int ply) {return frames[ply];}
+        int size();
+        //Forgets the killer moves of every ply
+        void clearKillers();
+
+    private:
+        unique_ptr<searchFrame[]> frames;
+        int plies;
+};
+
+#endif /* SEARCHSTACK_H_ */
@@ -0,0 +1,110 @@
+/*
+ * searchStats.cpp
+ * This file contains the function implementations for the searchStats class.
+ */
+
+#include "searchStats.h"
+#include <algorithm>
+#include <sstream>
+
+using namespace std;
+
+void threadStats::clear()
+{
+    nodes = 0;
+    qnodes = 0;
+    ttProbes = 0;
+    ttHits = 0;
+    cutoffs = 0;
+    firstMoveCutoffs = 0;
+    bitbaseHits = 0;
+    selDepth = 0;
+}
+
+string searchReport::toJson()
+{
+    ostringstream json;
+    json << "{\"depth\":" << depth << ",\"seldepth\":" << selDepth
+         << ",\"nodes\":" << nodes << ",\"qnodes\":" << qnodes
+         << ",\"time\":" << seconds << ",\"nps\":" << nps
+         << ",\"ttProbes\":" << ttProbes << ",\"ttHits\":" << ttHits << ",\"ttHitRate\":" << ttHitRate
+         << ",\"cutoffs\":" << cutoffs << ",\"firstMoveCutoffRate\":" << firstMoveCutoffRate
+         << ",\"bitbaseHits\":" << bitbaseHits << ",\"ebf\":" << ebf << "}";
+    return json.str();
+}
+
+searchStats::searchStats(int threadCount)
+{
+    numThreads = threadCount > 0 ? threadCount : 1;
+    threads.reset(new threadStats[numThreads]);
+}
+
+threadStats& searchStats::thread(int index)
+{
+    return threads[index];
+}
+
+void searchStats::clear()
+{
+    for(int i = 0; i < numThreads; i++)
+    {
+        threads[i].clear();
+    }
+    depthReports.clear();
+}
+
+long long searchStats::totalNodes()
+{
+    long long total = 0;
+    for(int i = 0; i < numThreads; i++)
+    {
+        total += threads[i].nodes.load(memory_order_relaxed);
+    }
+    return total;
+}
+
+searchReport searchStats::completeDepth(int depth, double seconds)
+{
+    searchReport report;
+    report.depth = depth;
+    report.seconds = seconds;
+
+    for(int i = 0; i < numThreads; i++)
+    {
+        report.nodes += threads[i].nodes.load(memory_order_relaxed);
+        report.qnodes += threads[i].qnodes.load(memory_order_relaxed);
+        report.ttProbes += threads[i].ttProbes.load(memory_order_relaxed);
+        report.ttHits += threads[i].ttHits.load(memory_order_relaxed);
+        report.cutoffs += threads[i].cutoffs.load(memory_order_relaxed);
+        report.firstMoveCutoffs += threads[i].firstMoveCutoffs.load(memory_order_relaxed);
+        report.bitbaseHits += threads[i].bitbaseHits.load(memory_order_relaxed);
+        report.selDepth = max(report.selDepth, threads[i].selDepth.load(memory_order_relaxed));
+    }
+
+    if(seconds > 0)
+        report.nps = (long long)(report.nodes / seconds);
+    if(report.ttProbes > 0)
+        report.ttHitRate = 100.0 * report.ttHits / report.ttProbes;
+    if(report.cutoffs > 0)
+        report.firstMoveCutoffRate = 100.0 * report.firstMoveCutoffs / report.cutoffs;
+
+    //the counters are totals since the search started, so each depth's nodes are the
+    //difference from the previous report
+    if(!depthReports.empty())
+    {
+        long long previousNodes = depthReports.back().nodes;
+        long long previousDepthNodes = previousNodes;
+        if(depthReports.size() > 1)
+            previousDepthNodes = previousNodes - depthReports[depthReports.size()-2].nodes;
+        if(previousDepthNodes > 0)
+            report.ebf = (double)(report.nodes - previousNodes) / previousDepthNodes;
+    }
+
+    depthReports.push_back(report);
+    return report;
+}
+
+vector<searchReport>& searchStats::reports()
+{
+    return depthReports;
+}
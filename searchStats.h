@@ -0,0 +1,85 @@
+/*
+ * searchStats.h
+ * This file contains the header information for the searchStats class and the
+ * counters it collects from every search thread.
+ */
+
+#ifndef SEARCHSTATS_H_
+#define SEARCHSTATS_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//The counters of a single search thread. Only the owning thread writes them, so an
+//increment is a relaxed load and store rather than a locked add, while other threads
+//can still read them to report totals during the search. Each thread's counters sit
+//on their own cache line.
+struct alignas(64) threadStats
+{
+    atomic<long long> nodes;
+    atomic<long long> qnodes;
+    atomic<long long> ttProbes;
+    atomic<long long> ttHits;
+    atomic<long long> cutoffs;
+    atomic<long long> firstMoveCutoffs;
+    atomic<long long> bitbaseHits;
+    atomic<int> selDepth;
+
+    threadStats() {clear();}
+    void clear();
+    void add(atomic<long long>& counter) {counter.store(counter.load(memory_order_relaxed) + 1, memory_order_relaxed);}
+    void reachPly(int ply) {if(ply > selDepth.load(memory_order_relaxed)) selDepth.store(ply, memory_order_relaxed);}
+};
+
+//The totals of every thread when a depth of the search was completed
+struct searchReport
+{
+    int depth = 0;
+    int selDepth = 0;
+    long long nodes = 0;
+    long long qnodes = 0;
+    long long ttProbes = 0;
+    long long ttHits = 0;
+    long long cutoffs = 0;
+    long long firstMoveCutoffs = 0;
+    long long bitbaseHits = 0;
+    double seconds = 0;
+    long long nps = 0;
+    //Percentage of probes finding an entry and of cutoffs made by the first action
+    double ttHitRate = 0;
+    double firstMoveCutoffRate = 0;
+    //Nodes of this depth divided by the nodes of the previous depth
+    double ebf = 0;
+
+    //Returns the report as a single line of JSON
+    string toJson();
+};
+
+//The searchStats class holds the counters of every thread of a search and turns
+//them into a report for each completed depth
+class searchStats
+{
+    public:
+        searchStats(int numThreads);
+
+        //Returns the counters of the thread with the given index
+        threadStats& thread(int index);
+        //Clears every counter and report before a new search
+        void clear();
+        long long totalNodes();
+        //Adds up every thread's counters and records the report of a completed depth
+        searchReport completeDepth(int depth, double seconds);
+        //Returns the report of every completed depth of the last search
+        vector<searchReport>& reports();
+
+    private:
+        unique_ptr<threadStats[]> threads;
+        int numThreads;
+        vector<searchReport> depthReports;
+};
+
+#endif /* SEARCHSTATS_H_ */
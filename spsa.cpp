@@ -0,0 +1,180 @@
+/*
+ * spsa.cpp
+ * This file contains the self-play games and the tuning loop of the spsa command.
+ */
+
+#include "spsa.h"
+#include "game.h"
+#include "ai.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+//Plays a game from a few random opening moves chosen by seed between players set by
+//whiteParams and blackParams. Returns the result for white: 1, 0.5 or 0. Games
+//running past MAX_PLIES are scored as draws.
+static double playGame(const searchParams& whiteParams, const searchParams& blackParams,
+                       unsigned int seed, double gameTime, double increment)
+{
+    const int OPENING_PLIES = 6;
+    const int MAX_PLIES = 300;
+    const int GAME_HASH_MB = 8;
+
+    game board;
+    board.initializeBoard();
+    board.setTimeControl(gameTime, increment, 0);
+
+    mt19937 random(seed);
+    for(int ply = 0; ply < OPENING_PLIES && !board.is_game_over(); ply++)
+    {
+        vector<action> moves = board.current_state.actions();
+        action move = moves[random() % moves.size()];
+        board.move_log.push_back(move);
+        board.update(move);
+    }
+
+    //players searching at the same time must not share history table files
+    ai white(0, '0');
+    ai black(0, '1');
+    ai* players[2] = {&white, &black};
+    for(int i = 0; i < 2; i++)
+    {
+        players[i]->params = (i == 0) ? whiteParams : blackParams;
+        players[i]->persistHistory = false;
+        players[i]->verbose = false;
+        players[i]->tt->resize(GAME_HASH_MB);
+        players[i]->target_game = &board;
+    }
+
+    int ending;
+    for(int ply = 0; (ending = board.is_game_over()) == 0; ply++)
+    {
+        if(ply >= MAX_PLIES)
+            return 0.5;
+        bool whiteToMove = (board.current_state.currentPlayer->rankDirection == 1);
+        gameClock::time_point startOfTurn = gameClock::now();
+        action move = players[whiteToMove ? 0 : 1]->runTurn();
+        double timePassed = secondsSince(startOfTurn);
+        if(whiteToMove)
+            board.whiteTimeRemaining -= timePassed;
+        else
+            board.blackTimeRemaining -= timePassed;
+        //running out of time loses before the increment is added back
+        if((whiteToMove ? board.whiteTimeRemaining : board.blackTimeRemaining) <= 0)
+            return whiteToMove ? 0 : 1;
+        //an illegal move loses the game
+        if(!board.valid_move(move))
+            return whiteToMove ? 0 : 1;
+        board.move_log.push_back(move);
+        board.update(move);
+        board.addTimeControlBonus(whiteToMove ? 1 : -1);
+    }
+
+    //see game::is_game_over() for the codes
+    if(ending == 2)
+        return (board.current_state.currentPlayer->rankDirection == 1) ? 0 : 1;
+    if(ending == 4)
+        return 0;
+    if(ending == 5)
+        return 1;
+    return 0.5;
+}
+
+//The gains follow the usual SPSA schedule: the perturbation of each parameter
+//shrinks to its finalStep and the step size to FINAL_LEARNING_RATE times the square
+//of finalStep per game won by a player over the course of the run. Both games of
+//a pair start from the same opening with the colors swapped.
+int runSPSA(const searchParams& start, int iterations, int gamesPerIteration, int threads,
+            double gameTime, double increment)
+{
+    const double ALPHA = 0.602;
+    const double GAMMA = 0.101;
+    const double FINAL_LEARNING_RATE = 0.002;
+
+    const vector<searchParam>& fields = searchParams::fields();
+    const int count = fields.size();
+    if(threads <= 0)
+        threads = max(1u, thread::hardware_concurrency());
+    gamesPerIteration += gamesPerIteration % 2;
+    double stability = 0.1 * iterations;
+    cout << "Playing " << gamesPerIteration << " games per iteration on " << threads << " threads" << endl;
+
+    vector<double> values(count);
+    vector<double> perturbations(count);
+    vector<double> learningRates(count);
+    for(int i = 0; i < count; i++)
+    {
+        values[i] = start.*fields[i].member;
+        perturbations[i] = fields[i].finalStep * pow(iterations, GAMMA);
+        learningRates[i] = FINAL_LEARNING_RATE * fields[i].finalStep * fields[i].finalStep *
+                           pow(stability + iterations, ALPHA);
+    }
+
+    searchParams current = start;
+    mt19937 random(random_device{}());
+    for(int iteration = 1; iteration <= iterations; iteration++)
+    {
+        searchParams plus = current;
+        searchParams minus = current;
+        vector<int> directions(count);
+        vector<double> steps(count);
+        for(int i = 0; i < count; i++)
+        {
+            directions[i] = (random() & 1) ? 1 : -1;
+            steps[i] = perturbations[i] / pow(iteration, GAMMA);
+            double offset = steps[i] * directions[i];
+            plus.*fields[i].member = min(fields[i].maximum, max(fields[i].minimum, (int)lround(values[i] + offset)));
+            minus.*fields[i].member = min(fields[i].maximum, max(fields[i].minimum, (int)lround(values[i] - offset)));
+        }
+
+        //the games are handed out to the threads one at a time
+        unsigned int seed = random();
+        vector<double> scores(gamesPerIteration);
+        atomic<int> nextGame(0);
+        vector<thread> workers;
+        for(int t = 0; t < threads; t++)
+        {
+            workers.emplace_back([&]()
+            {
+                int g;
+                while((g = nextGame.fetch_add(1)) < gamesPerIteration)
+                {
+                    unsigned int gameSeed = seed + g / 2;
+                    if(g % 2 == 0)
+                        scores[g] = playGame(plus, minus, gameSeed, gameTime, increment);
+                    else
+                        scores[g] = 1 - playGame(minus, plus, gameSeed, gameTime, increment);
+                }
+            });
+        }
+        for(unsigned int t = 0; t < workers.size(); t++)
+            workers[t].join();
+
+        //the wins of the plus player less its losses
+        double result = 0;
+        for(int g = 0; g < gamesPerIteration; g++)
+            result += 2 * scores[g] - 1;
+
+        for(int i = 0; i < count; i++)
+        {
+            double gain = learningRates[i] / pow(stability + iteration, ALPHA);
+            values[i] += gain / steps[i] * result * directions[i];
+            values[i] = min((double)fields[i].maximum, max((double)fields[i].minimum, values[i]));
+            current.*fields[i].member = (int)lround(values[i]);
+        }
+
+        cout << "Iteration " << iteration << " plus player result " << result << ": " << current.toString() << endl;
+    }
+
+    cout << "Tuned parameters:";
+    for(int i = 0; i < count; i++)
+        cout << " --param " << fields[i].name << "=" << current.*fields[i].member;
+    cout << endl;
+    return 0;
+}
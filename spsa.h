@@ -0,0 +1,21 @@
+/*
+ * spsa.h
+ * This file contains the header information for the spsa command, which tunes the
+ * search parameters by playing short games between two differently set players.
+ */
+
+#ifndef SPSA_H_
+#define SPSA_H_
+
+#include "searchParams.h"
+
+//Tunes the search parameters from start by simultaneous perturbation stochastic
+//approximation. Every iteration moves all parameters up or down at random for one
+//player and the opposite way for the other, plays gamesPerIteration games between
+//them on threads threads (every core when 0) with gameTime seconds and increment
+//seconds per move on each clock, and steps the parameters towards the winner. The
+//parameters are printed after every iteration. Returns 0.
+int runSPSA(const searchParams& start, int iterations, int gamesPerIteration, int threads,
+            double gameTime, double increment);
+
+#endif /* SPSA_H_ */
@@ -0,0 +1,115 @@
+/*
+ * timeManager.cpp
+ * This file contains the function implementations for the timeManager class.
+ */
+
+#include "timeManager.h"
+#include "game.h"
+#include <algorithm>
+
+using namespace std;
+
+//In sudden death params.percentTimeRemaining percent of the remaining time is planned for
+//each move. This gives more time early in the game and less towards the end, which
+//allows the early turns with more possible moves to go to deeper depths. Late game
+//depths are deeper anyway because fewer pieces have fewer moves to make.
+//With a known number of moves to the next time control the remaining time is split
+//evenly between them instead. Most of the increment is spent on every move.
+//params.openingTime percent is planned instead while no piece has been traded yet.
+void timeManager::init(searchLimits& newLimits, int phase, const searchParams& params)
+{
+    const double INCREMENT_USED = 0.75;
+    const double HARD_LIMIT_FACTOR = 2;
+    const double MAX_TIME_FRACTION = 0.6;
+    const double MOVE_OVERHEAD = 0.05;
+    const double MINIMUM_TIME = 0.01;
+
+    limits = newLimits;
+    stabilityScale = 1;
+    bestActionChanges = 0;
+    stableDepths = 0;
+    lastBestAction = -1;
+
+    if(limits.moveTime > 0)
+    {
+        optimumTime = max(MINIMUM_TIME, limits.moveTime - MOVE_OVERHEAD);
+        maximumTime = optimumTime;
+    }
+    else if(limits.time > 0)
+    {
+        int percent = params.percentTimeRemaining;
+        if(phase == state::MAX_PHASE)
+            percent = params.openingTime;
+
+        if(limits.movesToGo > 0)
+            optimumTime = limits.time / (limits.movesToGo + 1);
+        else
+            optimumTime = limits.time * percent / 100;
+        optimumTime += limits.increment * INCREMENT_USED;
+
+        maximumTime = min(optimumTime * HARD_LIMIT_FACTOR, (limits.time - MOVE_OVERHEAD) * MAX_TIME_FRACTION);
+        maximumTime = max(MINIMUM_TIME, maximumTime);
+        optimumTime = min(optimumTime, maximumTime);
+    }
+    else
+    {
+        optimumTime = 0;
+        maximumTime = 0;
+    }
+}
+
+bool timeManager::isTimed()
+{
+    return limits.moveTime > 0 || limits.time > 0;
+}
+
+//The optimum time scaled by the stability of the best action, never above the hard limit
+double timeManager::softLimit()
+{
+    return min(maximumTime, optimumTime * stabilityScale);
+}
+
+double timeManager::hardLimit()
+{
+    return maximumTime;
+}
+
+bool timeManager::depthLimitReached(int depth)
+{
+    return limits.depth > 0 && depth > limits.depth;
+}
+
+bool timeManager::nodeLimitReached(long long nodes)
+{
+    return limits.nodes > 0 && nodes >= limits.nodes;
+}
+
+//Every change of the best action adds to the time allowed and is forgotten by half
+//after each depth. Each depth in a row that keeps the same best action takes away
+//STABLE_STEP of the optimum time down to MIN_STABLE_SCALE.
+void timeManager::updateBestAction(int packedAction)
+{
+    const double STABLE_STEP = 0.1;
+    const double MIN_STABLE_SCALE = 0.5;
+    const double MAX_SCALE = 2.5;
+
+    if(lastBestAction != -1 && packedAction != lastBestAction)
+    {
+        bestActionChanges += 1;
+        stableDepths = 0;
+    }
+    else if(lastBestAction != -1)
+    {
+        stableDepths++;
+    }
+    lastBestAction = packedAction;
+
+    stabilityScale = (1 + bestActionChanges) * max(MIN_STABLE_SCALE, 1 - STABLE_STEP * stableDepths);
+    stabilityScale = min(MAX_SCALE, stabilityScale);
+    bestActionChanges /= 2;
+}
+
+int timeManager::stableDepthCount()
+{
+    return stableDepths;
+}
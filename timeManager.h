@@ -0,0 +1,59 @@
+/*
+ * timeManager.h
+ * This file contains the header information for the timeManager class.
+ */
+
+#ifndef TIMEMANAGER_H_
+#define TIMEMANAGER_H_
+
+#include "searchParams.h"
+
+//The limits a search is asked to respect. A value of 0 means the limit is not used.
+struct searchLimits
+{
+    //Seconds left on the player's clock and seconds added after every move
+    double time = 0;
+    double increment = 0;
+    //Moves left before the next time control, 0 for sudden death
+    int movesToGo = 0;
+    //Fixed number of seconds to spend on every move
+    double moveTime = 0;
+    //Maximum depth of the iterative deepening and maximum nodes searched
+    int depth = 0;
+    long long nodes = 0;
+};
+
+//The timeManager class decides how much of the clock a search may use. It
+//produces a soft limit after which no new depth is started and a hard limit
+//after which a running depth is abandoned. The soft limit is stretched while
+//the best action keeps changing between depths and shrunk once it is stable.
+class timeManager
+{
+    public:
+        //Calculates the time allowances for a new search from a state of the given
+        //game phase, planning the share of the clock params asks for
+        void init(searchLimits& newLimits, int phase, const searchParams& params);
+
+        //Returns true if the search is limited by the clock
+        bool isTimed();
+        double softLimit();
+        double hardLimit();
+        bool depthLimitReached(int depth);
+        bool nodeLimitReached(long long nodes);
+
+        //Records the best action found by a completed depth to judge its stability
+        void updateBestAction(int packedAction);
+        //Returns the number of depths in a row that kept the same best action
+        int stableDepthCount();
+
+    private:
+        searchLimits limits;
+        double optimumTime = 0;
+        double maximumTime = 0;
+        double stabilityScale = 1;
+        double bestActionChanges = 0;
+        int stableDepths = 0;
+        int lastBestAction = -1;
+};
+
+#endif /* TIMEMANAGER_H_ */
@@ -0,0 +1,85 @@
+/*
+ * transTable.cpp
+ * This file contains the function implementations for the transTable class.
+ */
+
+#include "transTable.h"
+
+using namespace std;
+
+transTable::transTable(int sizeMB)
+{
+    resize(sizeMB);
+}
+
+//The number of entries is rounded down to a power of two so the index can be
+//taken directly from the low bits of the key
+void transTable::resize(int sizeMB)
+{
+    unsigned long long bytes = (unsigned long long)(sizeMB > 0 ? sizeMB : 1) * 1024 * 1024;
+    numEntries = 1;
+    while(numEntries * 2 * sizeof(ttEntry) <= bytes)
+        numEntries *= 2;
+    entries.reset(new ttEntry[numEntries]);
+    clear();
+}
+
+void transTable::clear()
+{
+    for(unsigned long long i = 0; i < numEntries; i++)
+    {
+        entries[i].key.store(0, memory_order_relaxed);
+        entries[i].data.store(0, memory_order_relaxed);
+    }
+    generation = 0;
+}
+
+void transTable::newSearch()
+{
+    generation = (generation + 1) & 63;
+}
+
+//The data word is laid out as utility (32 bits), depth (8 bits), bound (2 bits),
+//generation (6 bits) and move (16 bits)
+bool transTable::probe(unsigned long long key, int& utility, int& depth, int& bound, int& move)
+{
+    ttEntry& e = entries[key & (numEntries - 1)];
+    unsigned long long data = e.data.load(memory_order_relaxed);
+    if((e.key.load(memory_order_relaxed) ^ data) != key || data == 0)
+        return false;
+
+    utility = (int)(unsigned int)(data & 0xFFFFFFFF);
+    depth = (int)((data >> 32) & 0xFF);
+    bound = (int)((data >> 40) & 0x3);
+    move = (int)((data >> 48) & 0xFFFF);
+    return true;
+}
+
+//Entries are replaced when they come from an older search, when the new result
+//was searched at least as deep, or when the new result is exact
+void transTable::store(unsigned long long key, int utility, int depth, int bound, int move)
+{
+    ttEntry& e = entries[key & (numEntries - 1)];
+    unsigned long long oldData = e.data.load(memory_order_relaxed);
+    if(oldData != 0)
+    {
+        int oldDepth = (int)((oldData >> 32) & 0xFF);
+        unsigned int oldGeneration = (unsigned int)((oldData >> 42) & 0x3F);
+        if(oldGeneration == generation && depth < oldDepth && bound != TT_EXACT)
+            return;
+    }
+
+    if(depth < 0)
+        depth = 0;
+    if(depth > 255)
+        depth = 255;
+
+    unsigned long long data = (unsigned long long)(unsigned int)utility;
+    data |= (unsigned long long)depth << 32;
+    data |= (unsigned long long)bound << 40;
+    data |= (unsigned long long)generation << 42;
+    data |= (unsigned long long)(move & 0xFFFF) << 48;
+
+    e.key.store(key ^ data, memory_order_relaxed);
+    e.data.store(data, memory_order_relaxed);
+}
@@ -0,0 +1,54 @@
+/*
+ * transTable.h
+ * This file contains the header information for the transTable class.
+ */
+
+#ifndef TRANSTABLE_H_
+#define TRANSTABLE_H_
+
+#include <atomic>
+#include <memory>
+
+using namespace std;
+
+//Bound types describing how a stored utility relates to the true minimax value
+const int TT_EXACT = 0;
+const int TT_LOWER = 1;
+const int TT_UPPER = 2;
+
+//A single slot of the table. The key is stored XOR'd with the data so a slot
+//that was torn by two threads writing at the same time fails verification
+//instead of returning another position's result.
+struct ttEntry
+{
+    atomic<unsigned long long> key;
+    atomic<unsigned long long> data;
+};
+
+//The transTable class stores the results of previously searched states keyed
+//by their Zobrist hash. It is shared by every search thread of an ai without
+//locks so helper threads can hand their results to the main thread.
+class transTable
+{
+    public:
+        transTable(int sizeMB);
+
+        //Reallocates the table to hold sizeMB megabytes of entries
+        void resize(int sizeMB);
+        //Removes all stored entries
+        void clear();
+        //Marks the start of a new search so entries from older searches are replaced first
+        void newSearch();
+
+        //Returns true and fills the out parameters if key has a stored entry
+        bool probe(unsigned long long key, int& utility, int& depth, int& bound, int& move);
+        //Stores the result of a searched state
+        void store(unsigned long long key, int utility, int depth, int bound, int move);
+
+    private:
+        unique_ptr<ttEntry[]> entries;
+        unsigned long long numEntries = 0;
+        unsigned int generation = 0;
+};
+
+#endif /* TRANSTABLE_H_ */
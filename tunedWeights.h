@@ -0,0 +1,29 @@
+/*
+ * tunedWeights.h
+ * This file is written by the tune command and holds the values the evaluation
+ * weights start with. Tuning again replaces it.
+ */
+
+#ifndef TUNEDWEIGHTS_H_
+#define TUNEDWEIGHTS_H_
+
+const int TUNED_PAWN_VALUE = 1000;
+const int TUNED_KNIGHT_VALUE = 3200;
+const int TUNED_BISHOP_VALUE = 3200;
+const int TUNED_ROOK_VALUE = 5000;
+const int TUNED_QUEEN_VALUE = 9000;
+const int TUNED_SAFETY_THRESH = 125;
+const int TUNED_QUEEN_BONUS_WEAK_KING = 200;
+const int TUNED_ROOK_ON_7 = 200;
+const int TUNED_ROOK_CONNECTED_ON_7 = 100;
+const int TUNED_ROOK_OPEN_FILE = 100;
+const int TUNED_ROOK_CONNECTED_OPEN_FILE = 50;
+const int TUNED_ROOK_HALF_OPEN_FILE = 50;
+const int TUNED_NUDGE = -10;
+const int TUNED_UNMOVED_PENALTY = -100;
+const int TUNED_QUEEN_IS_EARLY = -50;
+const int TUNED_CANT_CASTLE = -300;
+const int TUNED_NOT_YET_CASTLE = -150;
+const int TUNED_CASTLED = 2000;
+
+#endif /* TUNEDWEIGHTS_H_ */
@@ -0,0 +1,411 @@
+/*
+ * tuner.cpp
+ * This file contains the packed position format and the functions running the
+ * tune and packpositions commands.
+ */
+
+#include "tuner.h"
+#include "game.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+//A labelled position in 33 bytes so millions of them fit in memory. Each square
+//from a1 to h8 takes four bits, the low half of a byte first: 0 when empty, 1 to 6
+//for a white pawn, knight, bishop, rook, queen or king and 9 to 14 for black's.
+//Bit 0 of flags is set when black is to move, bits 1 to 4 hold the castling rights
+//KQkq and bits 5 and 6 the result: 0 black won, 1 draw, 2 white won.
+struct packedPosition
+{
+    unsigned char squares[32];
+    unsigned char flags;
+};
+
+static_assert(sizeof(packedPosition) == 33, "packedPosition must not be padded");
+
+//An evaluation weight the tuner adjusts and its name in tunedWeights.h
+struct weightField
+{
+    const char* name;
+    int evalWeights::* member;
+};
+
+static const weightField WEIGHT_FIELDS[] =
+{
+    {"PAWN_VALUE", &evalWeights::pawnValue},
+    {"KNIGHT_VALUE", &evalWeights::knightValue},
+    {"BISHOP_VALUE", &evalWeights::bishopValue},
+    {"ROOK_VALUE", &evalWeights::rookValue},
+    {"QUEEN_VALUE", &evalWeights::queenValue},
+    {"SAFETY_THRESH", &evalWeights::safetyThresh},
+    {"QUEEN_BONUS_WEAK_KING", &evalWeights::queenBonusWeakKing},
+    {"ROOK_ON_7", &evalWeights::rookOn7},
+    {"ROOK_CONNECTED_ON_7", &evalWeights::rookConnectedOn7},
+    {"ROOK_OPEN_FILE", &evalWeights::rookOpenFile},
+    {"ROOK_CONNECTED_OPEN_FILE", &evalWeights::rookConnectedOpenFile},
+    {"ROOK_HALF_OPEN_FILE", &evalWeights::rookHalfOpenFile},
+    {"NUDGE", &evalWeights::nudge},
+    {"UNMOVED_PENALTY", &evalWeights::unmovedPenalty},
+    {"QUEEN_IS_EARLY", &evalWeights::queenIsEarly},
+    {"CANT_CASTLE", &evalWeights::cantCastle},
+    {"NOT_YET_CASTLE", &evalWeights::notYetCastle},
+    {"CASTLED", &evalWeights::castled}
+};
+
+static const int WEIGHT_COUNT = sizeof(WEIGHT_FIELDS) / sizeof(WEIGHT_FIELDS[0]);
+
+static const string PIECE_LETTERS = " PNBRQK  pnbrqk";
+static const string CASTLING_LETTERS = "KQkq";
+
+//Packs the fields of a FEN and a result of 0, 1 or 2. Returns false if the
+//placement is malformed.
+static bool packFEN(const string& placement, const string& toMove, const string& castling,
+                    int result, packedPosition& packed)
+{
+    fill(packed.squares, packed.squares + 32, 0);
+    int rank = 7;
+    int file = 0;
+    for(unsigned int i = 0; i < placement.size(); i++)
+    {
+        char c = placement[i];
+        if(c == '/')
+        {
+            rank--;
+            file = 0;
+            continue;
+        }
+        if(c >= '1' && c <= '8')
+        {
+            file += c - '0';
+            continue;
+        }
+        size_t code = PIECE_LETTERS.find(c);
+        if(c == ' ' || code == string::npos || rank < 0 || file > 7)
+            return false;
+        int square = rank * 8 + file;
+        packed.squares[square / 2] |= code << ((square % 2) * 4);
+        file++;
+    }
+
+    packed.flags = (toMove == "b") ? 1 : 0;
+    for(int i = 0; i < 4; i++)
+    {
+        if(castling.find(CASTLING_LETTERS[i]) != string::npos)
+            packed.flags |= 1 << (i + 1);
+    }
+    packed.flags |= result << 5;
+    return true;
+}
+
+//Returns the FEN of a packed position
+static string unpackFEN(const packedPosition& packed)
+{
+    string fen;
+    for(int rank = 7; rank >= 0; rank--)
+    {
+        int empty = 0;
+        for(int file = 0; file < 8; file++)
+        {
+            int square = rank * 8 + file;
+            int code = (packed.squares[square / 2] >> ((square % 2) * 4)) & 15;
+            if(code == 0)
+            {
+                empty++;
+                continue;
+            }
+            if(empty > 0)
+                fen += (char)('0' + empty);
+            empty = 0;
+            fen += PIECE_LETTERS[code];
+        }
+        if(empty > 0)
+            fen += (char)('0' + empty);
+        if(rank > 0)
+            fen += '/';
+    }
+
+    fen += (packed.flags & 1) ? " b " : " w ";
+    string castling;
+    for(int i = 0; i < 4; i++)
+    {
+        if(packed.flags & (1 << (i + 1)))
+            castling += CASTLING_LETTERS[i];
+    }
+    fen += castling.empty() ? "-" : castling;
+    fen += " - 0 1";
+    return fen;
+}
+
+//Returns the result of a packed position as white's score: 0, 0.5 or 1
+static double packedResult(const packedPosition& packed)
+{
+    return ((packed.flags >> 5) & 3) / 2.0;
+}
+
+int packPositions(const string& textFile, const string& positionFile)
+{
+    ifstream in(textFile.c_str());
+    if(!in)
+    {
+        cerr << "Could not open " << textFile << endl;
+        return 1;
+    }
+    ofstream out(positionFile.c_str(), ios::binary);
+    if(!out)
+    {
+        cerr << "Could not create " << positionFile << endl;
+        return 1;
+    }
+
+    game position;
+    string line;
+    long long packedCount = 0;
+    long long skipped = 0;
+    while(getline(in, line))
+    {
+        int result;
+        //1/2-1/2 is looked for first since it contains neither of the others
+        if(line.find("1/2-1/2") != string::npos || line.find("[0.5]") != string::npos)
+            result = 1;
+        else if(line.find("1-0") != string::npos || line.find("[1.0]") != string::npos)
+            result = 2;
+        else if(line.find("0-1") != string::npos || line.find("[0.0]") != string::npos)
+            result = 0;
+        else
+        {
+            if(!line.empty())
+                skipped++;
+            continue;
+        }
+
+        //loadFEN() also turns away boards without one king per side or with the king
+        //of the player who just moved in check, which the evaluation cannot score
+        istringstream fields(line);
+        string placement, toMove, castling;
+        fields >> placement >> toMove >> castling;
+        packedPosition packed;
+        if(!packFEN(placement, toMove, castling, result, packed) || !position.loadFEN(unpackFEN(packed)))
+        {
+            skipped++;
+            continue;
+        }
+        out.write((const char*)&packed, sizeof(packed));
+        packedCount++;
+    }
+
+    cout << "Packed " << packedCount << " positions, skipped " << skipped << " lines" << endl;
+    return 0;
+}
+
+//Reads every packed position of positionFile into positions
+static bool loadPositions(const string& positionFile, vector<packedPosition>& positions)
+{
+    ifstream in(positionFile.c_str(), ios::binary | ios::ate);
+    if(!in)
+    {
+        cerr << "Could not open " << positionFile << endl;
+        return false;
+    }
+    streamoff size = in.tellg();
+    if(size <= 0 || size % sizeof(packedPosition) != 0)
+    {
+        cerr << positionFile << " does not hold packed positions" << endl;
+        return false;
+    }
+    positions.resize(size / sizeof(packedPosition));
+    in.seekg(0);
+    in.read((char*)positions.data(), size);
+    return (bool)in;
+}
+
+//Returns the advanced heuristic's utility for white of a packed position, loaded
+//into position so each thread sets up a single game for all of its positions
+static int evaluatePacked(game& position, const packedPosition& packed)
+{
+    position.loadFEN(unpackFEN(packed));
+    state& s = position.current_state;
+    s.maxPlayer = s.players[0];
+    s.updateMaterialDifference();
+    return s.calculateUtility(0);
+}
+
+//Returns the logistic loss of a utility for white given the result. K scales
+//utilities so that 4000 / K is the advantage giving white ten to one odds.
+static double logisticLoss(int utility, double result, double k)
+{
+    const double CLAMP = 1e-9;
+    double expected = 1.0 / (1.0 + pow(10.0, -k * utility / 4000.0));
+    expected = min(1.0 - CLAMP, max(CLAMP, expected));
+    return -(result * log(expected) + (1.0 - result) * log(1.0 - expected));
+}
+
+//Splits the positions into a contiguous chunk per thread and calls work(thread,
+//first, last) for each chunk on its own thread
+template <typename Work>
+static void forEachChunk(size_t count, int threads, Work work)
+{
+    vector<thread> workers;
+    size_t chunk = (count + threads - 1) / threads;
+    for(int t = 0; t < threads; t++)
+    {
+        size_t first = min(count, t * chunk);
+        size_t last = min(count, first + chunk);
+        workers.emplace_back(work, t, first, last);
+    }
+    for(unsigned int t = 0; t < workers.size(); t++)
+        workers[t].join();
+}
+
+//Returns the mean loss of the positions evaluated with the current weights
+static double meanLoss(const vector<packedPosition>& positions, int threads, double k)
+{
+    vector<double> sums(threads, 0);
+    forEachChunk(positions.size(), threads, [&](int t, size_t first, size_t last)
+    {
+        game position;
+        double sum = 0;
+        for(size_t i = first; i < last; i++)
+            sum += logisticLoss(evaluatePacked(position, positions[i]), packedResult(positions[i]), k);
+        sums[t] = sum;
+    });
+
+    double total = 0;
+    for(int t = 0; t < threads; t++)
+        total += sums[t];
+    return total / positions.size();
+}
+
+//Finds the K minimizing the loss of the starting weights, so the weights are
+//tuned against the scale the evaluation already has
+static double fitScale(const vector<packedPosition>& positions, int threads)
+{
+    vector<int> utilities(positions.size());
+    forEachChunk(positions.size(), threads, [&](int, size_t first, size_t last)
+    {
+        game position;
+        for(size_t i = first; i < last; i++)
+            utilities[i] = evaluatePacked(position, positions[i]);
+    });
+
+    //the loss is convex in K, so a ternary search finds its minimum
+    double low = 0.01;
+    double high = 10.0;
+    for(int step = 0; step < 50; step++)
+    {
+        double lowThird = low + (high - low) / 3;
+        double highThird = high - (high - low) / 3;
+        double lowLoss = 0;
+        double highLoss = 0;
+        for(size_t i = 0; i < positions.size(); i++)
+        {
+            lowLoss += logisticLoss(utilities[i], packedResult(positions[i]), lowThird);
+            highLoss += logisticLoss(utilities[i], packedResult(positions[i]), highThird);
+        }
+        if(lowLoss < highLoss)
+            high = highThird;
+        else
+            low = lowThird;
+    }
+    return (low + high) / 2;
+}
+
+//Writes the weights as the constants of tunedWeights.h
+static bool writeHeader(const string& headerFile, const evalWeights& w)
+{
+    ofstream out(headerFile.c_str());
+    if(!out)
+    {
+        cerr << "Could not write " << headerFile << endl;
+        return false;
+    }
+    out << "/*\n";
+    out << " * tunedWeights.h\n";
+    out << " * This file is written by the tune command and holds the values the evaluation\n";
+    out << " * weights start with. Tuning again replaces it.\n";
+    out << " */\n\n";
+    out << "#ifndef TUNEDWEIGHTS_H_\n";
+    out << "#define TUNEDWEIGHTS_H_\n\n";
+    for(int i = 0; i < WEIGHT_COUNT; i++)
+        out << "const int TUNED_" << WEIGHT_FIELDS[i].name << " = " << w.*WEIGHT_FIELDS[i].member << ";\n";
+    out << "\n#endif /* TUNEDWEIGHTS_H_ */\n";
+    return (bool)out;
+}
+
+//Each iteration estimates the gradient of the loss by evaluating every position
+//with each weight nudged up and down by about 2%, then takes an Adam step of about
+//1% of the weight's starting size. The weights stay integers for the evaluation,
+//so the steps accumulate in a real valued copy of them.
+int runTuner(const string& positionFile, const string& headerFile, int iterations, int threads)
+{
+    const double PERTURBATION = 0.02;
+    const double LEARNING_RATE = 0.01;
+    const double BETA1 = 0.9;
+    const double BETA2 = 0.999;
+    const double EPSILON = 1e-12;
+
+    vector<packedPosition> positions;
+    if(!loadPositions(positionFile, positions))
+        return 1;
+    if(threads <= 0)
+        threads = max(1u, thread::hardware_concurrency());
+    cout << "Loaded " << positions.size() << " positions, tuning on " << threads << " threads" << endl;
+
+    double k = fitScale(positions, threads);
+    cout << "Scale K " << k << ", loss " << meanLoss(positions, threads, k) << endl;
+
+    evalWeights w = state::weights;
+    double values[WEIGHT_COUNT];
+    double steps[WEIGHT_COUNT];
+    int deltas[WEIGHT_COUNT];
+    double firstMoment[WEIGHT_COUNT] = {};
+    double secondMoment[WEIGHT_COUNT] = {};
+    for(int i = 0; i < WEIGHT_COUNT; i++)
+    {
+        values[i] = w.*WEIGHT_FIELDS[i].member;
+        steps[i] = max(1.0, fabs(values[i]) * LEARNING_RATE);
+        deltas[i] = max(1, (int)lround(fabs(values[i]) * PERTURBATION));
+    }
+
+    for(int iteration = 1; iteration <= iterations; iteration++)
+    {
+        double gradient[WEIGHT_COUNT];
+        for(int i = 0; i < WEIGHT_COUNT; i++)
+        {
+            int base = w.*WEIGHT_FIELDS[i].member;
+            w.*WEIGHT_FIELDS[i].member = base + deltas[i];
+            state::setWeights(w);
+            double upLoss = meanLoss(positions, threads, k);
+            w.*WEIGHT_FIELDS[i].member = base - deltas[i];
+            state::setWeights(w);
+            double downLoss = meanLoss(positions, threads, k);
+            w.*WEIGHT_FIELDS[i].member = base;
+            gradient[i] = (upLoss - downLoss) / (2.0 * deltas[i]);
+        }
+
+        double firstCorrection = 1 - pow(BETA1, iteration);
+        double secondCorrection = 1 - pow(BETA2, iteration);
+        for(int i = 0; i < WEIGHT_COUNT; i++)
+        {
+            firstMoment[i] = BETA1 * firstMoment[i] + (1 - BETA1) * gradient[i];
+            secondMoment[i] = BETA2 * secondMoment[i] + (1 - BETA2) * gradient[i] * gradient[i];
+            values[i] -= steps[i] * (firstMoment[i] / firstCorrection) /
+                         (sqrt(secondMoment[i] / secondCorrection) + EPSILON);
+            w.*WEIGHT_FIELDS[i].member = (int)lround(values[i]);
+        }
+
+        state::setWeights(w);
+        cout << "Iteration " << iteration << " loss " << meanLoss(positions, threads, k) << endl;
+        if(!writeHeader(headerFile, w))
+            return 1;
+    }
+
+    for(int i = 0; i < WEIGHT_COUNT; i++)
+        cout << WEIGHT_FIELDS[i].name << " = " << w.*WEIGHT_FIELDS[i].member << endl;
+    return 0;
+}
@@ -0,0 +1,28 @@
+/*
+ * tuner.h
+ * This file contains the header information for the tune command, which fits the
+ * evaluation weights to the results of a set of labelled positions, and for the
+ * packpositions command preparing its input.
+ */
+
+#ifndef TUNER_H_
+#define TUNER_H_
+
+#include <string>
+
+using namespace std;
+
+//Reads textFile, a position per line as a FEN followed by the game's result written
+//as 1-0, 0-1 or 1/2-1/2 (or [1.0], [0.0], [0.5]), and writes the positions that
+//can be loaded to positionFile in the packed form runTuner() reads.
+//Returns 0 on success or 1 if a file could not be opened.
+int packPositions(const string& textFile, const string& positionFile);
+
+//Loads the packed positions of positionFile and adjusts the evalWeights by gradient
+//descent on the logistic loss between the advanced heuristic's utility and the game
+//results, evaluating the positions on threads threads (every core when 0). The
+//weights are written to headerFile after each of the iterations so a tuning run can
+//be stopped at any point. Returns 0 on success or 1 if the positions could not be read.
+int runTuner(const string& positionFile, const string& headerFile, int iterations, int threads);
+
+#endif /* TUNER_H_ */
@@ -0,0 +1,87 @@
+/*
+ * workPool.cpp
+ * This file contains the function implementations for the splitPoint and
+ * workPool classes.
+ */
+
+#include "workPool.h"
+#include "ai.h"
+
+using namespace std;
+
+bool splitPoint::isAborted()
+{
+    for(splitPoint* sp = this; sp != NULL; sp = sp->parent)
+    {
+        if(sp->aborted.load(memory_order_relaxed))
+            return true;
+    }
+    return false;
+}
+
+workPool::workPool(int numWorkers)
+{
+    queues.resize(numWorkers);
+    queueLocks.reset(new mutex[numWorkers]);
+    done = false;
+}
+
+void workPool::start(vector<ai>& workers)
+{
+    done = false;
+    for(unsigned int i = 0; i < workers.size(); i++)
+    {
+        threads.push_back(thread(&ai::workerLoop, &workers[i]));
+    }
+}
+
+void workPool::stop()
+{
+    done = true;
+    for(unsigned int i = 0; i < threads.size(); i++)
+    {
+        threads[i].join();
+    }
+    threads.clear();
+}
+
+bool workPool::isStopped()
+{
+    return done.load(memory_order_relaxed);
+}
+
+void workPool::push(int worker, splitTask& task)
+{
+    lock_guard<mutex> guard(queueLocks[worker]);
+    queues[worker].push_back(task);
+}
+
+//Takes the newest task from the worker's own deque
+bool workPool::pop(int worker, splitTask& task)
+{
+    lock_guard<mutex> guard(queueLocks[worker]);
+    if(queues[worker].empty())
+        return false;
+    task = queues[worker].back();
+    queues[worker].pop_back();
+    return true;
+}
+
+//Takes the oldest task from another worker's deque. The oldest tasks are
+//closest to the root so they hold the most work.
+bool workPool::steal(int thief, splitTask& task)
+{
+    int numWorkers = queues.size();
+    for(int i = 1; i < numWorkers; i++)
+    {
+        int victim = (thief + i) % numWorkers;
+        lock_guard<mutex> guard(queueLocks[victim]);
+        if(!queues[victim].empty())
+        {
+            task = queues[victim].front();
+            queues[victim].pop_front();
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,91 @@
+/*
+ * workPool.h
+ * This file contains the header information for the work-stealing thread pool
+ * used by the ai's Young Brothers Wait parallel search.
+ */
+
+#ifndef WORKPOOL_H_
+#define WORKPOOL_H_
+
+#include "game.h"
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+class ai;
+
+//A split point is a node of the game tree whose eldest brother has already been
+//searched, leaving the remaining actions to be searched in parallel. All threads
+//working on the node share its bounds and best action through the split point.
+struct splitPoint
+{
+    //The split point of the task the owning thread was executing, if any
+    splitPoint* parent = NULL;
+    //A copy of the node's state that is never modified so any thread can copy it
+    state nodeState;
+    bool isMaxNode = true;
+    int depth = 0;
+    int quiescentDepth = 0;
+    int ply = 0;
+    bool calcUtil = false;
+    //The node's utility, compared against by children that calculate their utility
+    int staticEval = 0;
+
+    //Shared search results protected by lock
+    mutex lock;
+    int alpha = 0;
+    int beta = 0;
+    int bestUtility = 0;
+    action bestAction;
+    bool cutoff = false;
+
+    //Set when an action at this node causes a cutoff so every thread still
+    //searching one of its subtrees abandons the work
+    atomic<bool> aborted;
+    //Number of actions that have not finished being searched
+    atomic<int> pending;
+
+    splitPoint() {aborted = false; pending = 0;}
+
+    //Returns true if this node or any node above it was cut off
+    bool isAborted();
+};
+
+//A single action of a split point waiting to be searched
+struct splitTask
+{
+    splitPoint* sp = NULL;
+    action move;
+};
+
+//The workPool class keeps a deque of tasks for every thread. A thread adds the
+//actions of its own split points to the back of its deque and takes them from the
+//back again, while idle threads steal the oldest tasks from the front of other
+//threads' deques.
+class workPool
+{
+    public:
+        workPool(int numWorkers);
+
+        //Starts a thread running the worker loop of every helper ai
+        void start(vector<ai>& workers);
+        //Stops and joins the helper threads
+        void stop();
+        bool isStopped();
+
+        void push(int worker, splitTask& task);
+        bool pop(int worker, splitTask& task);
+        bool steal(int thief, splitTask& task);
+
+    private:
+        vector<deque<splitTask>> queues;
+        unique_ptr<mutex[]> queueLocks;
+        vector<thread> threads;
+        atomic<bool> done;
+};
+
+#endif /* WORKPOOL_H_ */